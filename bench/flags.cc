@@ -0,0 +1,428 @@
+#include "flags.h"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Measures parse and lookup cost. Every benchmark prints one JSON object on
+// its own line of a JSON array, so results can be diffed or fed to a
+// regression tracker:
+//   {"name": "parse/1000", "iterations": 5000, "ns_per_op": 41.2}
+// Pass --quick to run every benchmark once with small inputs (used as a
+// smoke test).
+
+namespace {
+using clock_type = std::chrono::steady_clock;
+
+// Keeps the compiler from optimizing away results that are never used. Only
+// taking the address is not enough once a computation is inlined and has no
+// side effects, so where possible the value is also forced into memory.
+volatile std::uintptr_t sink;
+template <class T>
+void keep(const T& value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r"(&value) : "memory");
+#endif
+  sink = sink + reinterpret_cast<std::uintptr_t>(&value);
+}
+
+bool quick = false;
+bool first_result = true;
+
+// Owns a synthetic argv: argv[0] is the program name, argv[argc] is null.
+struct command_line {
+  command_line() { tokens.emplace_back("bench"); }
+
+  void add(std::string token) { tokens.push_back(std::move(token)); }
+
+  int argc() {
+    pointers.clear();
+    for (auto& token : tokens) pointers.push_back(token.data());
+    pointers.push_back(nullptr);
+    return static_cast<int>(tokens.size());
+  }
+  char** argv() { return pointers.data(); }
+
+  std::vector<std::string> tokens;
+  std::vector<char*> pointers;
+};
+
+// A realistic mix of tokens: packed options, options followed by a value,
+// valueless flags and positional arguments, over `keys` distinct keys.
+command_line mixed_command_line(const std::size_t tokens,
+                                const std::size_t keys) {
+  command_line line;
+  for (std::size_t i = 0; line.tokens.size() <= tokens; ++i) {
+    const auto key = "key" + std::to_string(i % keys);
+    switch (i % 4) {
+      case 0:
+        line.add("--" + key + "=" + std::to_string(i));
+        break;
+      case 1:
+        line.add("--" + key);
+        line.add(std::to_string(i) + ".5");
+        break;
+      case 2:
+        line.add("-" + key);
+        break;
+      default:
+        line.add("positional" + std::to_string(i));
+    }
+  }
+  line.tokens.resize(tokens + 1);
+  return line;
+}
+
+void report(const char* name, const std::uint64_t iterations,
+            const double nanoseconds) {
+  std::printf("%s\n  {\"name\": \"%s\", \"iterations\": %llu, "
+              "\"ns_per_op\": %.3f}",
+              first_result ? "[" : ",", name,
+              static_cast<unsigned long long>(iterations),
+              nanoseconds / static_cast<double>(iterations));
+  first_result = false;
+}
+
+// Runs op in growing batches until at least min_time has elapsed, then
+// reports the mean time per call.
+template <class Op>
+void run(const char* name, Op&& op) {
+  const auto min_time = std::chrono::milliseconds(quick ? 0 : 200);
+  std::uint64_t iterations = 0;
+  std::uint64_t batch = 1;
+  clock_type::duration elapsed{};
+  do {
+    const auto start = clock_type::now();
+    for (std::uint64_t i = 0; i < batch; ++i) op();
+    elapsed += clock_type::now() - start;
+    iterations += batch;
+    batch *= 2;
+  } while (elapsed < min_time);
+  report(name, iterations,
+         std::chrono::duration<double, std::nano>(elapsed).count());
+}
+
+void parse_benchmarks() {
+  for (std::size_t tokens = 10; tokens <= (quick ? 1000 : 1000000);
+       tokens *= 10) {
+    auto line = mixed_command_line(tokens, 64);
+    const int argc = line.argc();
+    char** argv = line.argv();
+    const auto name = "parse/" + std::to_string(tokens);
+    run(name.c_str(), [&] {
+      const flags::args args(argc, argv);
+      keep(args);
+    });
+  }
+}
+
+// A build tool's command line: clustered letters and attached values (-vj8),
+// read natively instead of being re-tokenized into --v --j=8 first.
+void short_option_benchmarks() {
+  command_line line;
+  for (std::size_t i = 0; i < (quick ? 10 : 1000); ++i) {
+    line.add("-vkj" + std::to_string(i % 16));
+    line.add("-o");
+    line.add("out" + std::to_string(i));
+  }
+  const int argc = line.argc();
+  char** argv = line.argv();
+  flags::parse_options options;
+  options.short_options = "vkj:o:";
+  run("parse/short", [&] {
+    const flags::args args(argc, argv, options);
+    keep(args);
+  });
+}
+
+// Counts what a stream_parser reports.
+struct event_counter {
+  void on_option(const std::string_view&,
+                 const std::optional<std::string_view>&) {
+    ++events;
+  }
+  void on_positional(const std::string_view&) { ++events; }
+  void on_skipped(const std::string_view&) { ++events; }
+
+  std::size_t events = 0;
+};
+
+// The mixed command line as text, fed in 4 KiB chunks as it would be read
+// from a socket.
+void stream_benchmarks() {
+  auto line = mixed_command_line(quick ? 1000 : 100000, 64);
+  std::string text;
+  for (const auto& token : line.tokens) text += token + ' ';
+  constexpr std::size_t chunk = 4096;
+  run("stream/4k", [&] {
+    event_counter counter;
+    flags::stream_parser<event_counter> parser(counter);
+    for (std::size_t i = 0; i < text.size(); i += chunk) {
+      parser.feed(std::string_view(text).substr(i, chunk));
+    }
+    parser.finish();
+    keep(counter.events);
+  });
+}
+
+// Forwarding every option of argv: through visit, through a hand-written loop
+// that only finds the options, and through a full args.
+void visit_benchmarks() {
+  auto line = mixed_command_line(quick ? 1000 : 100000, 64);
+  const int argc = line.argc();
+  char** argv = line.argv();
+  run("visit", [&] {
+    event_counter counter;
+    flags::visit(argc, argv, counter);
+    keep(counter.events);
+  });
+  run("visit/loop", [&] {
+    std::size_t events = 0;
+    for (int i = 1; i < argc; ++i) {
+      const std::string_view token(argv[i]);
+      events += !token.empty() && token[0] == '-' &&
+                token.find('=') != std::string_view::npos;
+    }
+    keep(events);
+  });
+  run("visit/args", [&] {
+    const flags::args args(argc, argv);
+    keep(args);
+  });
+}
+
+// Many short command lines, as a job scheduler would see them: a fresh args
+// per line, one reusable args for all of them, and batches.
+void batch_benchmarks() {
+  constexpr std::size_t count = 1000;
+  std::vector<command_line> storage;
+  std::vector<flags::command_line> lines;
+  storage.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    storage.push_back(mixed_command_line(10 + i % 20, 8));
+  }
+  for (auto& line : storage) lines.push_back({line.argc(), line.argv()});
+
+  run("batch/fresh", [&] {
+    for (const auto& line : lines) {
+      const flags::args args(line.argc, line.argv);
+      keep(args);
+    }
+  });
+  flags::reusable_args reusable;
+  run("batch/reusable", [&] {
+    for (const auto& line : lines) {
+      reusable.parse(line.argc, line.argv);
+      keep(reusable);
+    }
+  });
+  run("batch/sequential", [&] {
+    keep(flags::args_batch(lines.data(), lines.size()));
+  });
+  run("batch/parallel4", [&] {
+    keep(flags::args_batch::parallel(lines.data(), lines.size(), 4));
+  });
+}
+
+// A lazy lookup of an option near the front of a long command line, against
+// parsing the whole command line first.
+void lazy_benchmarks() {
+  const std::size_t tokens = quick ? 1000 : 100000;
+  auto line = mixed_command_line(tokens, 64);
+  const int argc = line.argc();
+  char** argv = line.argv();
+  const auto suffix = "/" + std::to_string(tokens);
+  run(("lazy/find" + suffix).c_str(), [&] {
+    const flags::lazy_args args(argc, argv);
+    keep(args.find<int>("key1"));
+  });
+  run(("lazy/get" + suffix).c_str(), [&] {
+    const flags::lazy_args args(argc, argv);
+    keep(args.get<int>("key1"));
+  });
+}
+
+struct typed_config {
+  bool flag;
+  std::string text;
+  int number;
+  double real;
+};
+
+template <class T>
+void get_benchmark(const char* name, const flags::args& args,
+                   const std::string_view& key) {
+  run(name, [&] { keep(args.get<T>(key)); });
+}
+
+void get_benchmarks() {
+  command_line line;
+  for (int i = 0; i < 100; ++i) {
+    line.add("--filler" + std::to_string(i) + "=" + std::to_string(i));
+  }
+  line.add("--bool");
+  line.add("--string=some value");
+  line.add("--int=42");
+  line.add("--double=42.42");
+  const int argc = line.argc();
+  const flags::args args(argc, line.argv());
+  get_benchmark<bool>("get/bool", args, "bool");
+  get_benchmark<std::string_view>("get/string_view", args, "string");
+  get_benchmark<std::string>("get/string", args, "string");
+  get_benchmark<int>("get/int", args, "int");
+  get_benchmark<double>("get/double", args, "double");
+  get_benchmark<int>("get/missing", args, "missing");
+
+  // The same read by a precomputed key, and through a resolved slot.
+  static constexpr flags::key int_key("int");
+  run("get/int/key", [&] { keep(args.get<int>(int_key)); });
+  const auto slot = args.resolve(int_key);
+  run("get/int/slot", [&] { keep(slot.get<int>()); });
+
+  // A worker starting from the serialized image instead of argv: opening it
+  // (which checks it) against parsing, then a read.
+  const std::string image = args.serialize();
+  // keep only takes an address, and opening allocates nothing, so the result
+  // goes into the sink for the check to be measured at all.
+  run("serialized/open", [&] {
+    const flags::serialized_args serialized(image.data(), image.size());
+    sink = sink + static_cast<bool>(serialized);
+  });
+  run("serialized/parse", [&] {
+    const flags::args parsed(argc, line.argv());
+    keep(parsed);
+  });
+  const flags::serialized_args serialized(image.data(), image.size());
+  run("serialized/get/int", [&] {
+    sink = sink + static_cast<std::uintptr_t>(*serialized.get<int>("int"));
+  });
+
+  // Reading a bool that has a value, one of each kind of word in turn.
+  constexpr std::array<std::string_view, 6> words{
+      {"false", "true", "no", "yes", "0", "1"}};
+  std::size_t word = 0;
+  run("coerce/bool", [&] {
+    keep(flags::detail::coerce<bool>(words[word++ % words.size()]));
+  });
+
+  // Four typed reads of a command line that passes exactly those options,
+  // one get at a time against a single extract.
+  command_line four;
+  four.add("--bool");
+  four.add("--string=some value");
+  four.add("--int=42");
+  four.add("--double=42.42");
+  const int four_argc = four.argc();
+  const flags::args four_args(four_argc, four.argv());
+  run("get/four", [&] {
+    keep(four_args.get<bool>("bool", false));
+    keep(four_args.get<std::string>("string", ""));
+    keep(four_args.get<int>("int", 0));
+    keep(four_args.get<double>("double", 0.0));
+  });
+  run("extract/four", [&] {
+    keep(four_args.extract(flags::field("bool", &typed_config::flag),
+                           flags::field("string", &typed_config::text, ""),
+                           flags::field("int", &typed_config::number, 0),
+                           flags::field("double", &typed_config::real, 0.0)));
+  });
+}
+
+void get_multiple_benchmarks() {
+  command_line line;
+  const std::size_t repeats = quick ? 100 : 10000;
+  for (std::size_t i = 0; i < repeats; ++i) {
+    line.add("--define=" + std::to_string(i));
+  }
+  const int argc = line.argc();
+  const flags::args args(argc, line.argv());
+  const auto suffix = "/" + std::to_string(repeats);
+  run(("get_multiple/int" + suffix).c_str(),
+      [&] { keep(args.get_multiple<int>("define")); });
+  run(("get_multiple/string_view" + suffix).c_str(),
+      [&] { keep(args.get_multiple<std::string_view>("define")); });
+  run(("get_multiple/string" + suffix).c_str(),
+      [&] { keep(args.get_multiple<std::string>("define")); });
+  run(("get_multiple_default/int" + suffix).c_str(),
+      [&] { keep(args.get_multiple<int>("define", 0)); });
+  run(("get_multiple_view/int" + suffix).c_str(), [&] {
+    long total = 0;
+    for (const auto value : args.get_multiple_view<int>("define")) {
+      total += value.value_or(0);
+    }
+    keep(total);
+  });
+}
+
+// Cold lookups touch a different key every time, over a map much larger than
+// the cache, so each one misses; warm lookups repeat the same key.
+void lookup_benchmarks() {
+  const std::size_t keys = quick ? 1000 : 200000;
+  command_line line;
+  for (std::size_t i = 0; i < keys; ++i) {
+    line.add("--key" + std::to_string(i) + "=" + std::to_string(i));
+  }
+  const int argc = line.argc();
+  const flags::args args(argc, line.argv());
+  std::vector<std::string> names;
+  for (std::size_t i = 0; i < keys; ++i) {
+    // Stride through the keys so consecutive lookups are far apart.
+    names.push_back("key" + std::to_string((i * 7919) % keys));
+  }
+  std::size_t next = 0;
+  run("lookup/cold", [&] {
+    keep(args.get<int>(names[next]));
+    if (++next == names.size()) next = 0;
+  });
+  run("lookup/warm", [&] { keep(args.get<int>(names[0])); });
+}
+
+// Hierarchical keys through the sorted option_index: exact lookups, a subtree
+// enumeration and abbreviation resolution.
+void index_benchmarks() {
+  const std::size_t keys = quick ? 1000 : 100000;
+  command_line line;
+  for (std::size_t i = 0; i < keys; ++i) {
+    line.add("--storage.shard" + std::to_string(i % 100) + ".key" +
+             std::to_string(i) + "=" + std::to_string(i));
+  }
+  const int argc = line.argc();
+  const flags::args args(argc, line.argv());
+  run("index/build", [&] { keep(flags::option_index(args)); });
+  const flags::option_index index(args);
+  run("index/find", [&] { keep(index.get<int>("storage.shard7.key7")); });
+  run("index/prefixed", [&] {
+    long total = 0;
+    for (const auto& entry : index.prefixed("storage.shard7.")) {
+      total += entry.get<int>().value_or(0);
+    }
+    keep(total);
+  });
+  run("index/resolve", [&] { keep(index.resolve("storage.shard7.key7")); });
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--quick") == 0) quick = true;
+  }
+  parse_benchmarks();
+  short_option_benchmarks();
+  stream_benchmarks();
+  visit_benchmarks();
+  batch_benchmarks();
+  lazy_benchmarks();
+  get_benchmarks();
+  get_multiple_benchmarks();
+  lookup_benchmarks();
+  index_benchmarks();
+  std::printf("\n]\n");
+  return 0;
+}
@@ -0,0 +1,2510 @@
+#ifndef FLAGS_ARGS_H_
+#define FLAGS_ARGS_H_
+
+// The map-backed API: flags::args and everything built on it. Values of
+// types without a flags::converter need flags/stream.h (or flags.h).
+
+#include "core.h"
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <new>
+#include <thread>
+#if defined(FLAGS_INSTRUMENTATION)
+#include <map>
+#endif
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <cstdio>
+#endif
+
+#if defined(_WIN32)
+#include <stdlib.h>
+#define FLAGS_ENVIRON _environ
+#elif defined(__APPLE__)
+#include <crt_externs.h>
+#define FLAGS_ENVIRON (*_NSGetEnviron())
+#else
+extern "C" char** environ;
+#define FLAGS_ENVIRON environ
+#endif
+
+namespace flags {
+// Behaviour switches for the argv parser.
+struct parse_options {
+  // Expand tokens of the form @path into the whitespace-separated tokens of
+  // the file at path (see detail::next_response_token). Response files may
+  // reference other response files, up to max_response_file_depth levels.
+  bool response_files = false;
+  int max_response_file_depth = 16;
+
+  // If not empty, environment variables starting with env_prefix are read
+  // once, at construction, as options that were not passed in argv. The
+  // prefix is stripped and the rest lowercased: APP_MAX_INFLIGHT=8 is read as
+  // --max_inflight=8. argv always takes precedence.
+  std::string_view env_prefix;
+  // The NULL-terminated NAME=value array to read instead of the process
+  // environment (e.g. the envp argument of main), if not null.
+  char** environment = nullptr;
+
+  // Read a valueless --no-foo as foo=false, resolved while parsing: every
+  // bool getter then reads foo as false, and the token after it is not its
+  // value. --no-foo=value is still the option no-foo.
+  bool negation = false;
+
+  // The getopt-style list of the single-letter options to read the POSIX way
+  // (see detail::short_option_table): with "vxj:", -vx is -v -x, and -j8 and
+  // -j 8 are both j=8. A letter followed by ':' takes a value. The letters
+  // and values stay views into argv. Other single-dash tokens are read as
+  // before.
+  std::string_view short_options;
+};
+
+// Selects the constructors of basic_args that copy the tokens instead of
+// referring to them.
+struct owning_t {
+  explicit owning_t() = default;
+};
+inline constexpr owning_t owning{};
+
+namespace detail {
+template <class Allocator, class T>
+using rebind_alloc =
+    typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+// A private copy of a command line: every token is copied into one block that
+// also holds the NULL-terminated pointer array and a reference count, so the
+// copy costs a single allocation. Copies share the block and moves steal it,
+// so neither touches the tokens and every view into them stays valid.
+template <class Allocator>
+class basic_owned_argv {
+ public:
+  // Owns nothing.
+  explicit basic_owned_argv(const Allocator& allocator = Allocator())
+      : allocator_(allocator) {}
+
+  basic_owned_argv(const int argc, const char* const* argv,
+                   const Allocator& allocator = Allocator())
+      : basic_owned_argv(argv, argv + argc, allocator) {}
+
+  // Copies every token in [first, last), each convertible to a string_view.
+  template <class Iterator>
+  basic_owned_argv(const Iterator first, const Iterator last,
+                   const Allocator& allocator)
+      : allocator_(allocator) {
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+    for (auto it = first; it != last; ++it, ++count) {
+      bytes += std::string_view(*it).size() + 1;
+    }
+    const std::size_t units = header_units + count + 1 +
+                              (bytes + sizeof(char*) - 1) / sizeof(char*);
+    block_ = std::allocator_traits<unit_allocator>::allocate(allocator_, units);
+    ::new (static_cast<void*>(block_)) std::atomic<std::size_t>(1);
+    ::new (static_cast<void*>(block_ + 1)) std::size_t(units);
+    char** pointers = block_ + header_units;
+    char* chars = reinterpret_cast<char*>(pointers + count + 1);
+    for (auto it = first; it != last; ++it) {
+      const std::string_view token(*it);
+      std::memcpy(chars, token.data(), token.size());
+      chars[token.size()] = '\0';
+      *pointers++ = chars;
+      chars += token.size() + 1;
+    }
+    *pointers = nullptr;
+    argc_ = static_cast<int>(count);
+  }
+
+  basic_owned_argv(const basic_owned_argv& other)
+      : allocator_(other.allocator_), block_(other.block_), argc_(other.argc_) {
+    if (block_) references().fetch_add(1, std::memory_order_relaxed);
+  }
+  basic_owned_argv(basic_owned_argv&& other) noexcept
+      : allocator_(other.allocator_), block_(other.block_), argc_(other.argc_) {
+    other.block_ = nullptr;
+    other.argc_ = 0;
+  }
+  basic_owned_argv& operator=(const basic_owned_argv&) = delete;
+
+  ~basic_owned_argv() {
+    if (!block_ ||
+        references().fetch_sub(1, std::memory_order_acq_rel) != 1) {
+      return;
+    }
+    const std::size_t units = *std::launder(
+        reinterpret_cast<std::size_t*>(block_ + 1));
+    references().~atomic();
+    std::allocator_traits<unit_allocator>::deallocate(allocator_, block_,
+                                                      units);
+  }
+
+  int argc() const { return argc_; }
+  // The NULL-terminated copy, or null if nothing is owned.
+  char** argv() const { return block_ ? block_ + header_units : nullptr; }
+
+ private:
+  using unit_allocator = rebind_alloc<Allocator, char*>;
+  // The reference count and the size of the block, in pointers.
+  static constexpr std::size_t header_units = 2;
+  static_assert(sizeof(std::atomic<std::size_t>) <= sizeof(char*) &&
+                alignof(std::atomic<std::size_t>) <= alignof(char*));
+
+  std::atomic<std::size_t>& references() const {
+    return *std::launder(reinterpret_cast<std::atomic<std::size_t>*>(block_));
+  }
+
+  unit_allocator allocator_;
+  char** block_ = nullptr;
+  int argc_ = 0;
+};
+
+using owned_argv = basic_owned_argv<std::allocator<char>>;
+
+#if defined(FLAGS_INSTRUMENTATION)
+// What a parse built with FLAGS_INSTRUMENTATION records. Shared by the copies
+// of the parser; all counters are relaxed atomics (or locked), so they can be
+// updated by concurrent readers.
+struct parse_counters {
+  std::chrono::nanoseconds parse_time{};
+  std::atomic<std::uint64_t> allocations{0};
+  // Reads of each passed option, by its position in the option table.
+  std::unique_ptr<std::atomic<std::uint64_t>[]> reads;
+  // Reads of options that were not passed, by name.
+  mutable std::mutex missed_mutex;
+  std::map<std::string, std::uint64_t, std::less<>> missed;
+};
+
+// Allocator counts every allocation it makes into a parse_counters.
+template <class T, class Allocator>
+struct counting_allocator : rebind_alloc<Allocator, T> {
+  using base = rebind_alloc<Allocator, T>;
+  using value_type = T;
+  using is_always_equal = std::false_type;
+  template <class U>
+  struct rebind {
+    using other = counting_allocator<U, Allocator>;
+  };
+
+  counting_allocator(const Allocator& allocator, parse_counters* counters)
+      : base(allocator), counters(counters) {}
+  template <class U>
+  counting_allocator(const counting_allocator<U, Allocator>& other)
+      : base(other), counters(other.counters) {}
+
+  T* allocate(const std::size_t n) {
+    counters->allocations.fetch_add(1, std::memory_order_relaxed);
+    return std::allocator_traits<base>::allocate(*this, n);
+  }
+  counting_allocator select_on_container_copy_construction() const {
+    return *this;
+  }
+  template <class U>
+  bool operator==(const counting_allocator<U, Allocator>& other) const {
+    return static_cast<const base&>(*this) == other &&
+           counters == other.counters;
+  }
+  template <class U>
+  bool operator!=(const counting_allocator<U, Allocator>& other) const {
+    return !(*this == other);
+  }
+
+  parse_counters* counters;
+};
+#endif
+
+// A non-owning, contiguous range of values in the value table. An empty span
+// means the option was not passed: if a key exists, there must be at least
+// one value.
+struct value_span {
+  constexpr const value_ref* begin() const { return begin_; }
+  constexpr const value_ref* end() const { return end_; }
+  constexpr std::size_t size() const { return end_ - begin_; }
+  constexpr bool empty() const { return begin_ == end_; }
+  constexpr const value_ref& operator[](const std::size_t index) const {
+    return begin_[index];
+  }
+
+  const value_ref* begin_ = nullptr;
+  const value_ref* end_ = nullptr;
+};
+
+// Where the values of one option live in the value table.
+struct value_range {
+  std::size_t begin = 0;
+  std::size_t count = 0;
+};
+
+// Every container of the parser draws its memory from the same allocator.
+template <class Allocator>
+using view_vector =
+    std::vector<std::string_view, rebind_alloc<Allocator, std::string_view>>;
+
+// A constexpr 64-bit hash of an option name, so that flags::key can hash its
+// name at compile time. Eight bytes are mixed per step; the bytes are
+// assembled one by one, which the compiler turns into a single load.
+constexpr std::uint64_t mix_hash(std::uint64_t hash) {
+  hash ^= hash >> 32;
+  hash *= 0xd6e8feb86659fd93ull;
+  return hash ^ (hash >> 32);
+}
+
+constexpr std::uint64_t hash_name(const std::string_view name) {
+  std::uint64_t hash = 0x9e3779b97f4a7c15ull ^ name.size();
+  std::size_t i = 0;
+  for (; i + 8 <= name.size(); i += 8) {
+    std::uint64_t word = 0;
+    for (std::size_t j = 0; j < 8; ++j) {
+      word |= std::uint64_t{static_cast<unsigned char>(name[i + j])} << 8 * j;
+    }
+    hash = mix_hash(hash ^ word);
+  }
+  std::uint64_t tail = 0;
+  for (std::size_t j = 0; i + j < name.size(); ++j) {
+    tail |= std::uint64_t{static_cast<unsigned char>(name[i + j])} << 8 * j;
+  }
+  return mix_hash(hash ^ tail);
+}
+
+// The options of a parse, each with the range of its values, in the order
+// they were first seen. The first inline_capacity options are stored in place
+// and found by a linear scan over one tag per option (its length and first
+// byte), four tags per SIMD compare where available, so a short command line
+// allocates nothing here. Past that, options spill into a vector and an open
+// addressing index over all of them is built. The index keeps the hash_name
+// of every option, so it grows without hashing a name again, and a lookup
+// may bring its own hash (see flags::key).
+template <class Allocator>
+class basic_option_table {
+ public:
+  using value_type = std::pair<std::string_view, value_range>;
+  static constexpr std::size_t inline_capacity = 8;
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  struct const_iterator {
+    const value_type& operator*() const { return (*table_)[index_]; }
+    const value_type* operator->() const { return &(*table_)[index_]; }
+    const_iterator& operator++() {
+      ++index_;
+      return *this;
+    }
+    bool operator==(const const_iterator& other) const {
+      return index_ == other.index_;
+    }
+    bool operator!=(const const_iterator& other) const {
+      return index_ != other.index_;
+    }
+
+    const basic_option_table* table_;
+    std::size_t index_;
+  };
+
+  explicit basic_option_table(const Allocator& allocator)
+      : overflow_(allocator), buckets_(allocator) {}
+
+  auto get_allocator() const { return overflow_.get_allocator(); }
+  std::size_t size() const { return size_; }
+  const_iterator begin() const { return {this, 0}; }
+  const_iterator end() const { return {this, size_}; }
+
+  value_type& operator[](const std::size_t i) {
+    return i < inline_capacity ? inline_[i] : overflow_[i - inline_capacity];
+  }
+  const value_type& operator[](const std::size_t i) const {
+    return i < inline_capacity ? inline_[i] : overflow_[i - inline_capacity];
+  }
+
+  // The position of the option, or npos.
+  std::size_t find(const std::string_view& name) const {
+    if (size_ > inline_capacity) return find_spilled(name, hash_name(name));
+    return find_inline(name);
+  }
+
+  // Same as find, with hash the hash_name of name.
+  std::size_t find(const std::string_view& name,
+                   const std::uint64_t hash) const {
+    if (size_ > inline_capacity) return find_spilled(name, hash);
+    return find_inline(name);
+  }
+
+  // The position of the option, added with an empty range if it is new, and
+  // whether it was added.
+  std::pair<std::size_t, bool> try_emplace(const std::string_view& name) {
+    if (size_ < inline_capacity) {
+      if (const auto i = find_inline(name); i != npos) return {i, false};
+      const std::size_t i = size_++;
+      inline_[i] = {name, value_range()};
+      tags_[i] = tag_of(name);
+      return {i, true};
+    }
+    if (size_ == inline_capacity) {
+      if (const auto i = find_inline(name); i != npos) return {i, false};
+      // After a clear, the buckets are already there.
+      if (buckets_.size() < 4 * inline_capacity) grow(4 * inline_capacity);
+      for (std::size_t j = 0; j < inline_capacity; ++j) {
+        insert(hash_name(inline_[j].first), j);
+      }
+      overflow_.push_back({name, value_range()});
+      insert(hash_name(name), size_);
+      return {size_++, true};
+    }
+    const auto hash = hash_name(name);
+    if (const auto i = find_spilled(name, hash); i != npos) return {i, false};
+    if (2 * (size_ + 1) > buckets_.size()) grow(2 * buckets_.size());
+    overflow_.push_back({name, value_range()});
+    insert(hash, size_);
+    return {size_++, true};
+  }
+
+  // Removes every option, keeping the allocated capacity.
+  void clear() {
+    overflow_.clear();
+    std::fill(buckets_.begin(), buckets_.end(), bucket());
+    size_ = 0;
+  }
+
+ private:
+  // An option of the spilled index: its position plus one (zero marks an
+  // empty bucket) and the hash of its name.
+  struct bucket {
+    std::uint64_t hash = 0;
+    std::size_t option = 0;
+  };
+
+  std::size_t find_spilled(const std::string_view& name,
+                           const std::uint64_t hash) const {
+    const std::size_t mask = buckets_.size() - 1;
+    for (std::size_t i = hash & mask;; i = (i + 1) & mask) {
+      const auto& bucket = buckets_[i];
+      if (!bucket.option) return npos;
+      if (bucket.hash == hash && (*this)[bucket.option - 1].first == name) {
+        return bucket.option - 1;
+      }
+    }
+  }
+
+  // Adds an option that is not in the index yet. There is always an empty
+  // bucket, since the index is kept at most half full.
+  void insert(const std::uint64_t hash, const std::size_t option) {
+    const std::size_t mask = buckets_.size() - 1;
+    std::size_t i = hash & mask;
+    while (buckets_[i].option) i = (i + 1) & mask;
+    buckets_[i] = {hash, option + 1};
+  }
+
+  // Rehashes into size buckets (a power of two) from the kept hashes.
+  void grow(const std::size_t size) {
+    decltype(buckets_) old(size, bucket(), buckets_.get_allocator());
+    old.swap(buckets_);
+    for (const auto& bucket : old) {
+      if (bucket.option) insert(bucket.hash, bucket.option - 1);
+    }
+  }
+
+  std::size_t find_inline(const std::string_view& name) const {
+    const std::uint32_t tag = tag_of(name);
+#if defined(FLAGS_SCAN_SSE2) || defined(FLAGS_SCAN_NEON)
+    // One bit per inline option whose tag matches.
+    std::uint32_t matches = 0;
+    for (std::size_t i = 0; i < inline_capacity; i += 4) {
+#if defined(FLAGS_SCAN_SSE2)
+      const __m128i tags =
+          _mm_load_si128(reinterpret_cast<const __m128i*>(tags_.data() + i));
+      const auto equal = _mm_cmpeq_epi32(tags, _mm_set1_epi32(
+                                                   static_cast<int>(tag)));
+      matches |= static_cast<std::uint32_t>(
+                     _mm_movemask_ps(_mm_castsi128_ps(equal)))
+                 << i;
+#else
+      // Narrowed to 16 bits per lane.
+      const std::uint64_t lanes = vget_lane_u64(
+          vreinterpret_u64_u16(vmovn_u32(
+              vceqq_u32(vld1q_u32(tags_.data() + i), vdupq_n_u32(tag)))),
+          0);
+      matches |= static_cast<std::uint32_t>(
+                     (lanes & 1) | (lanes >> 15 & 2) | (lanes >> 30 & 4) |
+                     (lanes >> 45 & 8))
+                 << i;
+#endif
+    }
+    matches &= (1u << size_) - 1;
+    for (; matches; matches &= matches - 1) {
+      const std::size_t i = __builtin_ctz(matches);
+      if (inline_[i].first == name) return i;
+    }
+#else
+    for (std::size_t i = 0; i < size_; ++i) {
+      if (tags_[i] == tag && inline_[i].first == name) return i;
+    }
+#endif
+    return npos;
+  }
+
+  static std::uint32_t tag_of(const std::string_view& name) {
+    const auto size = std::min<std::size_t>(name.size(), 0xffffff);
+    const auto first = name.empty() ? 0 : static_cast<unsigned char>(name[0]);
+    return static_cast<std::uint32_t>(size << 8 | first);
+  }
+
+  alignas(16) std::array<std::uint32_t, inline_capacity> tags_{};
+  std::array<value_type, inline_capacity> inline_{};
+  std::vector<value_type, rebind_alloc<Allocator, value_type>> overflow_;
+  std::vector<bucket, rebind_alloc<Allocator, bucket>> buckets_;
+  std::size_t size_ = 0;
+};
+
+// A read-only view of a whole file: memory-mapped where mmap is available,
+// read into a buffer otherwise. A file that cannot be opened is falsy.
+class mapped_file {
+ public:
+  explicit mapped_file(const char* path) {
+#if __has_include(<sys/mman.h>)
+    const int fd = ::open(path, O_RDONLY);
+    if (fd < 0) return;
+    struct stat status;
+    if (::fstat(fd, &status) == 0 && S_ISREG(status.st_mode)) {
+      size_ = static_cast<std::size_t>(status.st_size);
+      if (size_ == 0) {
+        valid_ = true;
+      } else if (void* data =
+                     ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                 data != MAP_FAILED) {
+        data_ = static_cast<const char*>(data);
+        valid_ = true;
+      }
+    }
+    ::close(fd);
+#else
+    std::FILE* file = std::fopen(path, "rb");
+    if (!file) return;
+    std::string buffer;
+    char chunk[4096];
+    for (std::size_t read; (read = std::fread(chunk, 1, sizeof(chunk), file));) {
+      buffer.append(chunk, read);
+    }
+    valid_ = !std::ferror(file);
+    std::fclose(file);
+    buffer_ = std::move(buffer);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#endif
+  }
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+  ~mapped_file() {
+#if __has_include(<sys/mman.h>)
+    if (data_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+  }
+
+  explicit operator bool() const { return valid_; }
+  std::string_view contents() const { return {data_, data_ ? size_ : 0}; }
+
+ private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+  bool valid_ = false;
+#if !__has_include(<sys/mman.h>)
+  std::string buffer_;
+#endif
+};
+
+// Pops the next token off the front of a response file's contents, or returns
+// nullopt once only whitespace is left. Tokens are separated by whitespace. A
+// token starting with a single or double quote runs until the matching quote
+// and may contain whitespace; the quotes are not part of it. Tokens are views
+// into the file, so no escape sequences are processed. Quoting only applies
+// at the start of a token: a quote inside one is an ordinary character, so
+// --name="a b" is split into --name="a and b".
+inline std::optional<std::string_view> next_response_token(
+    std::string_view& contents) {
+  constexpr std::string_view whitespace = " \t\n\v\f\r";
+  const auto start = contents.find_first_not_of(whitespace);
+  if (start == std::string_view::npos) {
+    contents = {};
+    return std::nullopt;
+  }
+  contents.remove_prefix(start);
+  if (const char quote = contents[0]; quote == '"' || quote == '\'') {
+    const auto end = contents.find(quote, 1);
+    const auto token = contents.substr(1, end == std::string_view::npos
+                                              ? std::string_view::npos
+                                              : end - 1);
+    contents.remove_prefix(end == std::string_view::npos ? contents.size()
+                                                         : end + 1);
+    return token;
+  }
+  const auto token = contents.substr(0, contents.find_first_of(whitespace));
+  contents.remove_prefix(token.size());
+  return token;
+}
+
+}  // namespace detail
+
+// An option name with its hash, computed once: at compile time for a
+// constant. Lookups with a key skip hashing the name, and basic_args::resolve
+// finds the option once, for reads that are only a dereference.
+//
+//   constexpr flags::key threads("threads");
+//   args.get<int>(threads);
+class key {
+ public:
+  constexpr explicit key(const std::string_view name)
+      : name_(name), hash_(detail::hash_name(name)) {}
+
+  constexpr std::string_view name() const { return name_; }
+  constexpr std::uint64_t hash() const { return hash_; }
+
+ private:
+  std::string_view name_;
+  std::uint64_t hash_;
+};
+
+namespace detail {
+// Parses the argv tokens (see tokenizer for the rules). The values of all
+// options live in one contiguous table in which each option owns a range, and
+// the option table only maps a name to its range; there is no per-option
+// vector. Short command lines keep both the option table and the value table
+// inside the parser.
+// All of the bookkeeping (index buckets, value and token vectors) is
+// obtained from the given allocator, so with an arena allocator the whole
+// parse performs no global allocation.
+// Tokens read from response files are views into the mapped files, which are
+// kept alive alongside the parser (and shared by its copies).
+// With FLAGS_INSTRUMENTATION, the parser also times itself, counts the
+// allocations of its internal tables (the positional and skipped vectors are
+// not counted) and counts the reads of every option.
+template <class Allocator>
+struct basic_parser {
+#if defined(FLAGS_INSTRUMENTATION)
+  using table_allocator = counting_allocator<char, Allocator>;
+#else
+  using table_allocator = Allocator;
+#endif
+
+  basic_parser(const int argc, char** argv,
+               const Allocator& allocator = Allocator())
+      : basic_parser(argc, argv, parse_options(), allocator) {}
+
+  basic_parser(const int argc, char** argv, const parse_options& options,
+               const Allocator& allocator = Allocator())
+      : options_(table_allocator_for(allocator)),
+        values_(table_allocator_for(allocator)),
+        positional_arguments_(allocator),
+        skipped_tokens_(allocator),
+        response_files_(table_allocator_for(allocator)) {
+    occurrence_buffer occurrences(get_table_allocator());
+    parse(argc, argv, options, occurrences);
+  }
+  basic_parser(const basic_parser&) = default;
+  basic_parser(basic_parser&&) = default;
+  basic_parser& operator=(const basic_parser&) = delete;
+
+  // Command lines with up to this many values keep them in place.
+  static constexpr std::size_t inline_values = 8;
+
+  // Values in command line order, tagged with the position of their option.
+  // They only exist while parsing, on the stack unless there are more than
+  // inline_values of them.
+  struct occurrence {
+    std::size_t option;
+    value_ref value;
+  };
+  struct occurrence_buffer {
+    explicit occurrence_buffer(const table_allocator& allocator)
+        : overflow(allocator) {}
+
+    void push_back(const occurrence& item) {
+      if (size < inline_values) {
+        items[size] = item;
+      } else {
+        overflow.push_back(item);
+      }
+      ++size;
+    }
+    const occurrence& operator[](const std::size_t i) const {
+      return i < inline_values ? items[i] : overflow[i - inline_values];
+    }
+    void clear() {
+      overflow.clear();
+      size = 0;
+    }
+
+    std::array<occurrence, inline_values> items;
+    std::vector<occurrence, rebind_alloc<table_allocator, occurrence>> overflow;
+    std::size_t size = 0;
+  };
+
+  // The allocator of the internal tables, e.g. for an occurrence_buffer.
+  table_allocator get_table_allocator() const {
+    return options_.get_allocator();
+  }
+
+  // Forgets the previous command line and parses this one in its place,
+  // reusing the capacity of every table, and of occurrences, which the caller
+  // may keep across calls too.
+  void reparse(const int argc, char** argv, const parse_options& options,
+               occurrence_buffer& occurrences) {
+    options_.clear();
+    values_.clear();
+    positional_arguments_.clear();
+    skipped_tokens_.clear();
+    response_files_.clear();
+    environment_.reset();
+    occurrences.clear();
+#if defined(FLAGS_INSTRUMENTATION)
+    {
+      const std::lock_guard<std::mutex> lock(counters_->missed_mutex);
+      counters_->missed.clear();
+    }
+#endif
+    parse(argc, argv, options, occurrences);
+  }
+
+  // All of the values passed for the option, in order, or an empty span if it
+  // was not passed.
+  value_span values(const std::string_view& option) const {
+    return values_at(options_.find(option), option);
+  }
+
+  // Same as values(name), without hashing the name.
+  value_span values(const key& option) const {
+    return values_at(options_.find(option.name(), option.hash()),
+                     option.name());
+  }
+
+  // The values of an entry of options().
+  value_span values(const value_range& range) const {
+    const auto* begin =
+        (values_.empty() ? inline_values_.data() : values_.data()) +
+        range.begin;
+    return {begin, begin + range.count};
+  }
+
+  const basic_option_table<table_allocator>& options() const {
+    return options_;
+  }
+
+#if defined(FLAGS_INSTRUMENTATION)
+  const parse_counters& counters() const { return *counters_; }
+#endif
+  const view_vector<Allocator>& positional_arguments() const {
+    return positional_arguments_;
+  }
+  const view_vector<Allocator>& skipped_tokens() const {
+    return skipped_tokens_;
+  }
+
+ private:
+  friend struct tokenizer<basic_parser>;
+
+  // The values of the option at position i of the table, or none if it is
+  // npos, counted as a read of option.
+  value_span values_at(const std::size_t i,
+                       const std::string_view& option) const {
+    if (i != options_.npos) {
+#if defined(FLAGS_INSTRUMENTATION)
+      counters_->reads[i].fetch_add(1, std::memory_order_relaxed);
+#endif
+      return values(options_[i].second);
+    }
+#if defined(FLAGS_INSTRUMENTATION)
+    const std::lock_guard<std::mutex> lock(counters_->missed_mutex);
+    auto it = counters_->missed.find(option);
+    if (it == counters_->missed.end()) {
+      it = counters_->missed.emplace(std::string(option), 0).first;
+    }
+    ++it->second;
+#else
+    static_cast<void>(option);
+#endif
+    return {};
+  }
+
+  void parse(const int argc, char** argv, const parse_options& options,
+             occurrence_buffer& occurrences) {
+#if defined(FLAGS_INSTRUMENTATION)
+    const auto start = std::chrono::steady_clock::now();
+#endif
+    occurrences_ = &occurrences;
+    tokenizer<basic_parser> tokens(*this, options.negation,
+                                   short_option_table(options.short_options));
+    const int depth =
+        options.response_files ? options.max_response_file_depth : 0;
+    for (int i = 1; i < argc; ++i) feed(tokens, argv[i], depth);
+    tokens.finish();
+    if (!options.env_prefix.empty()) {
+      read_environment(options.environment ? options.environment
+                                           : FLAGS_ENVIRON,
+                       options.env_prefix);
+    }
+    group();
+    occurrences_ = nullptr;
+#if defined(FLAGS_INSTRUMENTATION)
+    counters_->reads.reset(new std::atomic<std::uint64_t>[options_.size()]());
+    counters_->parse_time = std::chrono::steady_clock::now() - start;
+#endif
+  }
+
+  void on_option(const std::string_view& option,
+                 const std::optional<std::string_view>& value) {
+    // try_emplace will insert an empty range if needed
+    const auto i = options_.try_emplace(option).first;
+    ++options_[i].second.count;
+    occurrences_->push_back({i, value});
+  }
+  void on_positional(const std::string_view& value) {
+    positional_arguments_.emplace_back(value);
+  }
+  void on_skipped(const std::string_view& value) {
+    skipped_tokens_.emplace_back(value);
+  }
+
+  // Feeds a token to the tokenizer, first expanding it if it names a response
+  // file. A token whose file cannot be read is kept as is.
+  void feed(tokenizer<basic_parser>& tokens, const char* token,
+            const int depth) {
+    // argv entries are NUL-terminated, so the path needs no copy.
+    if (depth > 0 && token[0] == '@' && token[1] && !tokens.skipping() &&
+        expand(tokens, token + 1, depth)) {
+      return;
+    }
+    tokens.feed(token);
+  }
+
+  void feed(tokenizer<basic_parser>& tokens, const std::string_view& token,
+            const int depth) {
+    if (depth > 0 && token.size() > 1 && token[0] == '@' &&
+        !tokens.skipping()) {
+      const std::basic_string<char, std::char_traits<char>,
+                              rebind_alloc<table_allocator, char>>
+          path(token.substr(1), response_files_.get_allocator());
+      if (expand(tokens, path.c_str(), depth)) return;
+    }
+    tokens.feed(token);
+  }
+
+  // Feeds the tokens of the response file at path, if it can be read.
+  bool expand(tokenizer<basic_parser>& tokens, const char* path,
+              const int depth) {
+    auto file =
+        std::allocate_shared<mapped_file>(response_files_.get_allocator(), path);
+    if (!*file) return false;
+    auto contents = file->contents();
+    response_files_.push_back(std::move(file));
+    while (const auto item = next_response_token(contents)) {
+      feed(tokens, *item, depth - 1);
+    }
+    return true;
+  }
+
+  // Adds every NAME=value entry of environment whose name starts with prefix
+  // as an option, unless argv already had it. The names and values are copied
+  // into a single pool up front, so later lookups never touch the (mutable,
+  // not thread-safe) process environment again.
+  void read_environment(char** environment, const std::string_view& prefix) {
+    const auto matches = [&prefix](const std::string_view& entry) {
+      return entry.size() > prefix.size() &&
+             entry.compare(0, prefix.size(), prefix) == 0 &&
+             entry[prefix.size()] != '=' &&
+             entry.find('=') != std::string_view::npos;
+    };
+    std::size_t size = 0;
+    for (char** entry = environment; entry && *entry; ++entry) {
+      if (const std::string_view view(*entry); matches(view)) {
+        size += view.size() - prefix.size();
+      }
+    }
+    if (!size) return;
+
+    const rebind_alloc<table_allocator, char> allocator(
+        response_files_.get_allocator());
+    auto pool = std::allocate_shared<environment_pool>(
+        allocator, environment_pool(allocator));
+    pool->reserve(size);
+    for (char** entry = environment; *entry; ++entry) {
+      std::string_view view(*entry);
+      if (!matches(view)) continue;
+      view.remove_prefix(prefix.size());
+      const auto delimiter = view.find('=');
+      // The pool never reallocates, so views into it stay valid.
+      const auto* name = pool->data() + pool->size();
+      for (const char c : view.substr(0, delimiter)) {
+        pool->push_back(static_cast<char>(
+            std::tolower(static_cast<unsigned char>(c))));
+      }
+      const auto* value = pool->data() + pool->size();
+      pool->append(view.substr(delimiter + 1));
+      const auto [i, inserted] =
+          options_.try_emplace(std::string_view(name, delimiter));
+      // argv, or an earlier entry for the same name, takes precedence.
+      if (!inserted) continue;
+      ++options_[i].second.count;
+      occurrences_->push_back(
+          {i, value_ref(std::string_view(value, view.size() - delimiter - 1))});
+    }
+    environment_ = std::move(pool);
+  }
+
+  // Lays the values out contiguously per option (a counting sort keyed on
+  // the option), preserving command line order within each option.
+  void group() {
+    std::size_t offset = 0;
+    for (std::size_t i = 0; i < options_.size(); ++i) {
+      auto& range = options_[i].second;
+      range.begin = offset;
+      offset += range.count;
+      range.count = 0;
+    }
+    if (occurrences_->size > inline_values) {
+      values_.resize(occurrences_->size);
+    }
+    value_ref* values = values_.empty() ? inline_values_.data() : values_.data();
+    for (std::size_t i = 0; i < occurrences_->size; ++i) {
+      const auto& [option, value] = (*occurrences_)[i];
+      auto& range = options_[option].second;
+      values[range.begin + range.count++] = value;
+    }
+  }
+
+#if defined(FLAGS_INSTRUMENTATION)
+  table_allocator table_allocator_for(const Allocator& allocator) {
+    return table_allocator(allocator, counters_.get());
+  }
+#else
+  static const Allocator& table_allocator_for(const Allocator& allocator) {
+    return allocator;
+  }
+#endif
+
+#if defined(FLAGS_INSTRUMENTATION)
+  // First, since the allocators of the other members point into it.
+  std::shared_ptr<parse_counters> counters_ =
+      std::make_shared<parse_counters>();
+#endif
+  basic_option_table<table_allocator> options_;
+  // The value table: inline_values_ unless it does not fit, then values_.
+  std::array<value_ref, inline_values> inline_values_;
+  std::vector<value_ref, rebind_alloc<table_allocator, value_ref>> values_;
+  view_vector<Allocator> positional_arguments_;
+  view_vector<Allocator> skipped_tokens_;
+  // Only set during construction.
+  occurrence_buffer* occurrences_ = nullptr;
+  std::vector<
+      std::shared_ptr<const mapped_file>,
+      rebind_alloc<table_allocator, std::shared_ptr<const mapped_file>>>
+      response_files_;
+  using environment_pool =
+      std::basic_string<char, std::char_traits<char>,
+                        rebind_alloc<table_allocator, char>>;
+  std::shared_ptr<const environment_pool> environment_;
+};
+
+using parser = basic_parser<std::allocator<char>>;
+
+// Coerces the first value of an option into <T>.
+// If the value cannot be properly parsed or the option was not passed (the
+// span is empty), returns nullopt.
+template <class T>
+std::optional<T> get(const value_span& values) {
+  if (values.empty()) return std::nullopt;
+  return coerce<T>(values[0].get());
+}
+
+// Coerces the values of an option into std::vector<T>.
+// If a value cannot be properly parsed, nullopt is added in its place. If the
+// option was not passed, the vector is empty.
+template <class T>
+std::vector<std::optional<T>> get_multiple(const value_span& values) {
+  std::vector<std::optional<T>> coerced;
+  coerced.reserve(values.size());
+  for (const auto& value : values) {
+    coerced.push_back(coerce<T>(value.get()));
+  }
+  return coerced;
+}
+
+}  // namespace detail
+
+// A lazy, non-owning view over all of the values passed for an option. Each
+// value is coerced into <T> (with the same rules as get_multiple) only when it
+// is dereferenced; nothing is copied or materialized up front. The view is
+// valid for as long as the args it came from.
+template <class T>
+struct values_view {
+  struct iterator {
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::optional<T>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::optional<T>;
+
+    reference operator*() const { return detail::coerce<T>(value_->get()); }
+    iterator& operator++() {
+      ++value_;
+      return *this;
+    }
+    iterator operator++(int) {
+      auto previous = *this;
+      ++value_;
+      return previous;
+    }
+    bool operator==(const iterator& other) const {
+      return value_ == other.value_;
+    }
+    bool operator!=(const iterator& other) const {
+      return value_ != other.value_;
+    }
+
+    const detail::value_ref* value_;
+  };
+
+  explicit values_view(const detail::value_span& values) : values_(values) {}
+
+  iterator begin() const { return {values_.begin()}; }
+  iterator end() const { return {values_.end()}; }
+  std::size_t size() const { return values_.size(); }
+  bool empty() const { return values_.empty(); }
+  std::optional<T> operator[](const std::size_t index) const {
+    return detail::coerce<T>(values_[index].get());
+  }
+
+ private:
+  detail::value_span values_;
+};
+
+// The values of one option, found once by basic_args::resolve: every read is
+// then a dereference, with no lookup. Like values_view, the slot is valid for
+// as long as the args it came from, and is not moved along with it.
+struct option_slot {
+  // Whether the option was passed.
+  bool passed() const { return !values.empty(); }
+
+  template <class T>
+  std::optional<T> get() const {
+    return detail::get<T>(values);
+  }
+
+  template <class T>
+  T get(T&& default_value) const {
+    return get<T>().value_or(default_value);
+  }
+
+  template <class T>
+  std::vector<std::optional<T>> get_multiple() const {
+    return detail::get_multiple<T>(values);
+  }
+
+  template <class T>
+  values_view<T> get_multiple_view() const {
+    return values_view<T>(values);
+  }
+
+  detail::value_span values;
+};
+
+// Binds an option to a member of S for basic_args::extract: the first value
+// of --name, coerced into T, or default_value if it was not passed.
+template <class S, class T>
+struct field {
+  constexpr field(const std::string_view name, T S::*member,
+                  T default_value = T())
+      : name(name), member(member), default_value(std::move(default_value)) {}
+
+  std::string_view name;
+  T S::*member;
+  T default_value;
+};
+
+// Lets the default be anything convertible to the member's type, such as a
+// string literal for a std::string member.
+template <class S, class T, class D>
+field(std::string_view, T S::*, D) -> field<S, T>;
+
+// The struct filled by basic_args::extract, with every problem found on the
+// way.
+template <class S>
+struct extraction {
+  bool ok() const { return unknown.empty() && errors.empty(); }
+
+  S value;
+  // Passed options that none of the fields names, sorted.
+  std::vector<std::string_view> unknown;
+  // Fields whose value could not be coerced, in field order; they keep their
+  // default.
+  std::vector<conversion_error> errors;
+};
+
+#if defined(FLAGS_INSTRUMENTATION)
+// What basic_args::stats reports with FLAGS_INSTRUMENTATION defined.
+struct parse_stats {
+  struct option_reads {
+    std::string name;
+    // Whether the option was passed at all; reads of options that were not
+    // passed usually point at a misspelled flag.
+    bool passed;
+    std::uint64_t reads;
+  };
+
+  // Wall time spent in the constructor, including response files and the
+  // environment.
+  std::chrono::nanoseconds parse_time;
+  // Allocations made by the parser's internal tables.
+  std::uint64_t allocations;
+  // The passed options in parse order, then the missed ones by name.
+  std::vector<option_reads> options;
+
+  // The stats as one JSON object:
+  //   {"parse_time_ns":1200,"allocations":0,
+  //    "options":[{"name":"port","passed":true,"reads":3}]}
+  std::string json() const {
+    std::string out = "{\"parse_time_ns\":" +
+                      std::to_string(parse_time.count()) +
+                      ",\"allocations\":" + std::to_string(allocations) +
+                      ",\"options\":[";
+    for (std::size_t i = 0; i < options.size(); ++i) {
+      if (i) out += ',';
+      out += "{\"name\":\"";
+      for (const char c : options[i].name) {
+        if (c == '"' || c == '\\') {
+          out += '\\';
+          out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+          static constexpr char hex[] = "0123456789abcdef";
+          out += "\\u00";
+          out += hex[(c >> 4) & 0xf];
+          out += hex[c & 0xf];
+        } else {
+          out += c;
+        }
+      }
+      out += "\",\"passed\":";
+      out += options[i].passed ? "true" : "false";
+      out += ",\"reads\":" + std::to_string(options[i].reads) + '}';
+    }
+    out += "]}";
+    return out;
+  }
+};
+#endif
+
+namespace detail {
+// The binary image written by basic_args::serialize and read in place by
+// serialized_args. Every field is a native-endian std::uint32_t and every
+// position is an offset, so the image can be mapped anywhere:
+//   header      image_magic, total size, then the number of options, values,
+//               positional arguments and skipped tokens
+//   options     {name, name size, first value, value count} per option,
+//               sorted by image_format::before
+//   values      {offset, size} per value, the values of each option together
+//               in command line order
+//   positional  {offset, size} per positional argument
+//   skipped     {offset, size} per skipped token
+//   pool        the bytes of every name and value
+// String offsets are relative to the pool. A valueless occurrence has offset
+// valueless, and a --no-foo one negated. Fields are read with memcpy, so the
+// image needs no particular alignment.
+struct image_format {
+  static constexpr std::uint32_t magic = 0x31474c46;  // "FLG1"
+  static constexpr std::uint32_t valueless = 0xffffffff;
+  static constexpr std::uint32_t negated = 0xfffffffe;
+  static constexpr std::size_t header_words = 6;
+  static constexpr std::size_t option_words = 4;
+  static constexpr std::size_t string_words = 2;
+
+  static void put(std::string& out, const std::size_t word) {
+    const auto value = static_cast<std::uint32_t>(word);
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+  }
+  // Shorter names first, so that most comparisons of a lookup stop at the
+  // sizes.
+  static bool before(const std::string_view& a, const std::string_view& b) {
+    return a.size() != b.size() ? a.size() < b.size() : a < b;
+  }
+
+  static std::uint32_t load(const char* data, const std::size_t word) {
+    std::uint32_t value;
+    std::memcpy(&value, data + word * sizeof(value), sizeof(value));
+    return value;
+  }
+};
+
+// Writes the image of a parse. Returns an empty string if it would not fit
+// the 32-bit offsets.
+template <class Parser>
+std::string serialize(const Parser& parser) {
+  using format = image_format;
+  const auto& options = parser.options();
+  std::vector<std::size_t> order(options.size());
+  for (std::size_t i = 0; i < order.size(); ++i) order[i] = i;
+  std::sort(order.begin(), order.end(),
+            [&options](const std::size_t a, const std::size_t b) {
+              return format::before(options[a].first, options[b].first);
+            });
+
+  std::size_t value_count = 0;
+  std::size_t pool_size = 0;
+  for (const auto& option : options) {
+    value_count += option.second.count;
+    pool_size += option.first.size();
+    for (const auto& value : parser.values(option.second)) {
+      if (value.data != negated_value) pool_size += value.size;
+    }
+  }
+  for (const auto& token : parser.positional_arguments()) {
+    pool_size += token.size();
+  }
+  for (const auto& token : parser.skipped_tokens()) pool_size += token.size();
+  const std::size_t words =
+      format::header_words + format::option_words * options.size() +
+      format::string_words *
+          (value_count + parser.positional_arguments().size() +
+           parser.skipped_tokens().size());
+  const std::size_t size = words * sizeof(std::uint32_t) + pool_size;
+  if (size >= format::negated) return {};
+
+  std::string out;
+  out.reserve(size);
+  std::string pool;
+  pool.reserve(pool_size);
+  const auto put_string = [&out, &pool](const std::string_view& text) {
+    format::put(out, pool.size());
+    format::put(out, text.size());
+    pool.append(text);
+  };
+  format::put(out, format::magic);
+  format::put(out, size);
+  format::put(out, options.size());
+  format::put(out, value_count);
+  format::put(out, parser.positional_arguments().size());
+  format::put(out, parser.skipped_tokens().size());
+  std::size_t first_value = 0;
+  for (const auto i : order) {
+    put_string(options[i].first);
+    format::put(out, first_value);
+    format::put(out, options[i].second.count);
+    first_value += options[i].second.count;
+  }
+  for (const auto i : order) {
+    for (const auto& value : parser.values(options[i].second)) {
+      if (!value.data) {
+        format::put(out, format::valueless);
+        format::put(out, 0);
+      } else if (value.data == negated_value) {
+        format::put(out, format::negated);
+        format::put(out, 0);
+      } else {
+        put_string(std::string_view(value.data, value.size));
+      }
+    }
+  }
+  for (const auto& token : parser.positional_arguments()) put_string(token);
+  for (const auto& token : parser.skipped_tokens()) put_string(token);
+  out += pool;
+  return out;
+}
+}  // namespace detail
+
+// Parses argv once and exposes typed getters over the result. Allocator is
+// used for all of the parser's bookkeeping; see flags::pmr::args to parse
+// into a caller-supplied arena.
+// The getters are const and never modify the object, so any number of threads
+// may read the same args concurrently without locking.
+//
+// The values refer into argv, which must outlive the args, unless it is
+// constructed with flags::owning: then the tokens are first copied into a
+// single block (see detail::basic_owned_argv) that moves and copies with the
+// args, so it can be built from a transient buffer and handed elsewhere.
+template <class Allocator = std::allocator<char>>
+struct basic_args {
+  basic_args(const int argc, char** argv,
+             const Allocator& allocator = Allocator())
+      : tokens_(allocator), parser_(argc, argv, allocator) {}
+
+  basic_args(const int argc, char** argv, const parse_options& options,
+             const Allocator& allocator = Allocator())
+      : tokens_(allocator), parser_(argc, argv, options, allocator) {}
+
+  basic_args(owning_t, const int argc, const char* const* argv,
+             const Allocator& allocator = Allocator())
+      : basic_args(owning, argc, argv, parse_options(), allocator) {}
+
+  basic_args(owning_t, const int argc, const char* const* argv,
+             const parse_options& options,
+             const Allocator& allocator = Allocator())
+      : tokens_(argc, argv, allocator),
+        parser_(tokens_.argc(), tokens_.argv(), options, allocator) {}
+
+  // Copies a whole command line, such as a std::vector<std::string>, whose
+  // first token is the program name just like argv[0].
+  template <class Tokens,
+            class = decltype(std::begin(std::declval<const Tokens&>()))>
+  basic_args(owning_t, const Tokens& tokens,
+             const Allocator& allocator = Allocator())
+      : basic_args(owning, tokens, parse_options(), allocator) {}
+
+  template <class Tokens,
+            class = decltype(std::begin(std::declval<const Tokens&>()))>
+  basic_args(owning_t, const Tokens& tokens, const parse_options& options,
+             const Allocator& allocator = Allocator())
+      : tokens_(std::begin(tokens), std::end(tokens), allocator),
+        parser_(tokens_.argc(), tokens_.argv(), options, allocator) {}
+
+  template <class T>
+  std::optional<T> get(const std::string_view& option) const {
+    return detail::get<T>(parser_.values(option));
+  }
+
+  template <class T>
+  T get(const std::string_view& option, T&& default_value) const {
+    return get<T>(option).value_or(default_value);
+  }
+
+  template <class T>
+  std::vector<std::optional<T>> get_multiple(const std::string_view& option) const {
+    return detail::get_multiple<T>(parser_.values(option));
+  }
+
+  template <class T>
+  std::vector<T> get_multiple(const std::string_view& option, T&& default_value) const {
+    return with_default(get_multiple_view<T>(option), default_value);
+  }
+
+  // Same as get_multiple without building a vector: each value is coerced as
+  // the view is iterated.
+  template <class T>
+  values_view<T> get_multiple_view(const std::string_view& option) const {
+    return values_view<T>(parser_.values(option));
+  }
+
+  // The getters above, looked up with the precomputed hash of a key.
+  template <class T>
+  std::optional<T> get(const key& option) const {
+    return detail::get<T>(parser_.values(option));
+  }
+
+  template <class T>
+  T get(const key& option, T&& default_value) const {
+    return get<T>(option).value_or(default_value);
+  }
+
+  template <class T>
+  std::vector<std::optional<T>> get_multiple(const key& option) const {
+    return detail::get_multiple<T>(parser_.values(option));
+  }
+
+  template <class T>
+  std::vector<T> get_multiple(const key& option, T&& default_value) const {
+    return with_default(get_multiple_view<T>(option), default_value);
+  }
+
+  template <class T>
+  values_view<T> get_multiple_view(const key& option) const {
+    return values_view<T>(parser_.values(option));
+  }
+
+  // Finds the option once, for reads in a loop:
+  //   const auto verbose = args.resolve(flags::key("verbose"));
+  //   while (...) if (verbose.get<bool>(false)) ...
+  option_slot resolve(const key& option) const {
+    return {parser_.values(option)};
+  }
+
+  template <class T>
+  std::optional<T> get(size_t positional_index) const {
+    return detail::get<T>(parser_.positional_arguments(), positional_index);
+  }
+
+  template <class T>
+  T get(size_t positional_index, T&& default_value) const {
+    return get<T>(positional_index).value_or(default_value);
+  }
+
+  const detail::view_vector<Allocator>& positional() const {
+    return parser_.positional_arguments();
+  }
+
+  const detail::view_vector<Allocator>& skipped() const {
+    return parser_.skipped_tokens();
+  }
+
+  // Fills an S from a table of fields and reports every problem at once,
+  // instead of one get per field that each have to be checked:
+  //   const auto config = args.extract(
+  //       flags::field("threads", &config::threads, 4),
+  //       flags::field("name", &config::name, "default"));
+  // Field names must be distinct. The parsed options are only walked, to list
+  // the unknown ones, if some of them were not matched by a field.
+  template <class S, class... Ts>
+  extraction<S> extract(const field<S, Ts>&... fields) const {
+    extraction<S> result{};
+    // The first value of each matched option identifies it in the table.
+    std::array<const detail::value_ref*, sizeof...(Ts)> matched{};
+    std::size_t i = 0;
+    (assign(result, fields, matched[i++]), ...);
+    const auto found = static_cast<std::size_t>(
+        std::count_if(matched.begin(), matched.end(),
+                      [](const detail::value_ref* value) { return value; }));
+    if (found < parser_.options().size()) {
+      for (const auto& option : parser_.options()) {
+        if (std::find(matched.begin(), matched.end(),
+                      parser_.values(option.second).begin()) ==
+            matched.end()) {
+          result.unknown.push_back(option.first);
+        }
+      }
+      std::sort(result.unknown.begin(), result.unknown.end());
+    }
+    return result;
+  }
+
+  // The whole parse (argv, response files and the environment resolved) as a
+  // position-independent binary image, for serialized_args to read in place
+  // in another process. Empty if the command line is larger than 4 GiB.
+  std::string serialize() const { return detail::serialize(parser_); }
+
+#if defined(FLAGS_INSTRUMENTATION)
+  // A snapshot of the parse time, allocation count and per-option reads so
+  // far. Safe to call while other threads are reading.
+  parse_stats stats() const {
+    const auto& counters = parser_.counters();
+    parse_stats stats{counters.parse_time,
+                      counters.allocations.load(std::memory_order_relaxed),
+                      {}};
+    const auto& options = parser_.options();
+    for (std::size_t i = 0; i < options.size(); ++i) {
+      stats.options.push_back(
+          {std::string(options[i].first), true,
+           counters.reads[i].load(std::memory_order_relaxed)});
+    }
+    const std::lock_guard<std::mutex> lock(counters.missed_mutex);
+    for (const auto& [name, reads] : counters.missed) {
+      stats.options.push_back({name, false, reads});
+    }
+    return stats;
+  }
+#endif
+
+ private:
+  template <class>
+  friend class basic_option_index;
+  template <class>
+  friend class basic_reusable_args;
+
+  template <class T>
+  static std::vector<T> with_default(const values_view<T>& items,
+                                     const T& default_value) {
+    std::vector<T> values;
+    values.reserve(items.size());
+    for (const auto& item : items) {
+      values.push_back(item ? *item : default_value);
+    }
+    return values;
+  }
+
+  template <class S, class T>
+  void assign(extraction<S>& result, const field<S, T>& field,
+              const detail::value_ref*& matched) const {
+    const auto values = parser_.values(field.name);
+    if (values.empty()) {
+      result.value.*field.member = field.default_value;
+      return;
+    }
+    matched = values.begin();
+    const auto value = values[0].get();
+    if (auto coerced = detail::coerce<T>(value)) {
+      result.value.*field.member = std::move(*coerced);
+    } else {
+      result.value.*field.member = field.default_value;
+      result.errors.push_back({field.name, value});
+    }
+  }
+
+  // Empty unless constructed with flags::owning. Declared first, since the
+  // parser refers into it.
+  detail::basic_owned_argv<Allocator> tokens_;
+  // Not const, so that moving the args moves the parser's tables; nothing
+  // modifies it after construction.
+  detail::basic_parser<Allocator> parser_;
+};
+
+using args = basic_args<>;
+
+// A basic_args that parses one command line after another in place, for
+// programs that handle many of them (e.g. validating submitted jobs). Every
+// table keeps its capacity across parse() calls, so once it has seen a
+// command line of some size, parsing another of that size allocates nothing.
+// parse() and reset() must not run concurrently with reads.
+template <class Allocator = std::allocator<char>>
+class basic_reusable_args : public basic_args<Allocator> {
+ public:
+  explicit basic_reusable_args(const Allocator& allocator = Allocator())
+      : basic_reusable_args(parse_options(), allocator) {}
+
+  explicit basic_reusable_args(const parse_options& options,
+                               const Allocator& allocator = Allocator())
+      : basic_args<Allocator>(0, nullptr, allocator),
+        options_(options),
+        occurrences_(this->parser_.get_table_allocator()) {}
+
+  // Replaces the current command line. argv must outlive the next parse() or
+  // reset().
+  void parse(const int argc, char** argv) {
+    this->parser_.reparse(argc, argv, options_, occurrences_);
+  }
+
+  // Forgets the current command line, without reading the environment again.
+  void reset() {
+    this->parser_.reparse(0, nullptr, parse_options(), occurrences_);
+  }
+
+ private:
+  using parser_type = detail::basic_parser<Allocator>;
+
+  parse_options options_;
+  typename parser_type::occurrence_buffer occurrences_;
+};
+
+using reusable_args = basic_reusable_args<>;
+
+// One command line of a basic_args_batch.
+struct command_line {
+  int argc;
+  char** argv;
+};
+
+// Parses many command lines at once into one array of basic_args, allocated
+// with a single call to Allocator, which every args then uses for its own
+// tables. With a flags::pmr::args_batch over a monotonic_buffer_resource, the
+// whole batch lives in one arena and is released at once. argv of every
+// line must outlive the batch.
+template <class Allocator = std::allocator<char>>
+class basic_args_batch {
+ public:
+  using value_type = basic_args<Allocator>;
+
+  basic_args_batch(const command_line* lines, const std::size_t count,
+                   const Allocator& allocator = Allocator())
+      : basic_args_batch(lines, count, parse_options(), allocator) {}
+
+  basic_args_batch(const command_line* lines, const std::size_t count,
+                   const parse_options& options,
+                   const Allocator& allocator = Allocator())
+      : basic_args_batch(count, allocator) {
+    std::size_t built = 0;
+    try {
+      build(lines, 0, count, options, built);
+    } catch (...) {
+      destroy(0, built);
+      size_ = 0;
+      throw;
+    }
+  }
+
+  // Splits the lines into `threads` contiguous chunks and parses them
+  // concurrently, one std::thread per chunk besides the calling thread. The
+  // allocator is shared by all of them, so it must be thread-safe:
+  // std::allocator is, and so is a std::pmr::synchronized_pool_resource,
+  // but a monotonic_buffer_resource is not.
+  static basic_args_batch parallel(
+      const command_line* lines, const std::size_t count, std::size_t threads,
+      const parse_options& options = parse_options(),
+      const Allocator& allocator = Allocator()) {
+    basic_args_batch batch(count, allocator);
+    threads = std::max<std::size_t>(1, std::min(threads, count));
+    std::vector<std::size_t> built(threads);
+    std::vector<std::exception_ptr> errors(threads);
+    const auto chunk = [&](const std::size_t i) {
+      try {
+        batch.build(lines, count * i / threads, count * (i + 1) / threads,
+                    options, built[i]);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t i = 1; i < threads; ++i) workers.emplace_back(chunk, i);
+    chunk(0);
+    for (auto& worker : workers) worker.join();
+    for (const auto& error : errors) {
+      if (!error) continue;
+      for (std::size_t i = 0; i < threads; ++i) {
+        const std::size_t begin = count * i / threads;
+        batch.destroy(begin, begin + built[i]);
+      }
+      batch.size_ = 0;
+      std::rethrow_exception(error);
+    }
+    return batch;
+  }
+
+  basic_args_batch(basic_args_batch&& other) noexcept
+      : allocator_(other.allocator_),
+        items_(other.items_),
+        size_(other.size_),
+        capacity_(other.capacity_) {
+    other.items_ = nullptr;
+    other.size_ = other.capacity_ = 0;
+  }
+  basic_args_batch(const basic_args_batch&) = delete;
+  basic_args_batch& operator=(const basic_args_batch&) = delete;
+
+  ~basic_args_batch() {
+    destroy(0, size_);
+    if (items_) traits::deallocate(allocator_, items_, capacity_);
+  }
+
+  std::size_t size() const { return size_; }
+  const value_type& operator[](const std::size_t i) const { return items_[i]; }
+  const value_type* begin() const { return items_; }
+  const value_type* end() const { return items_ + size_; }
+
+ private:
+  using item_allocator = detail::rebind_alloc<Allocator, value_type>;
+  using traits = std::allocator_traits<item_allocator>;
+
+  // Allocates room for count args, all of which the caller constructs.
+  basic_args_batch(const std::size_t count, const Allocator& allocator)
+      : allocator_(allocator),
+        items_(count ? traits::allocate(allocator_, count) : nullptr),
+        size_(count),
+        capacity_(count) {}
+
+  // Constructs the args of lines [begin, end); built counts those that were.
+  void build(const command_line* lines, const std::size_t begin,
+             const std::size_t end, const parse_options& options,
+             std::size_t& built) {
+    for (std::size_t i = begin; i < end; ++i, ++built) {
+      ::new (static_cast<void*>(items_ + i))
+          value_type(lines[i].argc, lines[i].argv, options, Allocator(allocator_));
+    }
+  }
+
+  void destroy(const std::size_t begin, const std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) items_[i].~value_type();
+  }
+
+  item_allocator allocator_;
+  value_type* items_;
+  std::size_t size_;
+  std::size_t capacity_;
+};
+
+using args_batch = basic_args_batch<>;
+
+// A sorted index over the option names of a basic_args, for hierarchical names
+// such as storage.cache.size. Besides exact lookups without hashing the name,
+// it enumerates every option under a prefix and resolves GNU-style
+// abbreviations, all by binary search. Each entry refers directly to the
+// option's values, so reading them costs no further lookup. The index is
+// valid for as long as the args it was built from, and is not moved along
+// with it: the values of a short command line live inside the args.
+template <class Allocator = std::allocator<char>>
+class basic_option_index {
+ public:
+  struct entry {
+    template <class T>
+    std::optional<T> get() const {
+      return detail::get<T>(values);
+    }
+    template <class T>
+    values_view<T> get_multiple_view() const {
+      return values_view<T>(values);
+    }
+
+    std::string_view name;
+    detail::value_span values;
+  };
+
+  // A contiguous run of entries, in name order.
+  struct entry_range {
+    const entry* begin() const { return begin_; }
+    const entry* end() const { return end_; }
+    std::size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+
+    const entry* begin_;
+    const entry* end_;
+  };
+
+  explicit basic_option_index(const basic_args<Allocator>& args)
+      : entries_(args.parser_.positional_arguments().get_allocator()) {
+    const auto& parser = args.parser_;
+    entries_.reserve(parser.options().size());
+    for (const auto& option : parser.options()) {
+      entries_.push_back({option.first, parser.values(option.second)});
+    }
+    std::sort(entries_.begin(), entries_.end(),
+              [](const entry& a, const entry& b) { return a.name < b.name; });
+  }
+
+  // The entry named exactly name, or nullptr.
+  const entry* find(const std::string_view& name) const {
+    const auto it = lower_bound(name);
+    return it != entries_.end() && it->name == name ? &*it : nullptr;
+  }
+
+  // Every option whose name starts with prefix, e.g. "storage.".
+  entry_range prefixed(const std::string_view& prefix) const {
+    const auto first = lower_bound(prefix);
+    const auto last =
+        std::partition_point(first, entries_.end(), [&](const entry& e) {
+          return e.name.substr(0, prefix.size()) == prefix;
+        });
+    return {entries_.data() + (first - entries_.begin()),
+            entries_.data() + (last - entries_.begin())};
+  }
+
+  // The option named abbreviation, or else the only option whose name starts
+  // with it; nullptr if there is none or the abbreviation is ambiguous.
+  const entry* resolve(const std::string_view& abbreviation) const {
+    const auto candidates = prefixed(abbreviation);
+    if (candidates.empty()) return nullptr;
+    if (candidates.size() == 1 || candidates.begin()->name == abbreviation) {
+      return candidates.begin();
+    }
+    return nullptr;
+  }
+
+  template <class T>
+  std::optional<T> get(const std::string_view& name) const {
+    const auto* found = find(name);
+    return found ? found->template get<T>() : std::nullopt;
+  }
+
+  template <class T>
+  T get(const std::string_view& name, T&& default_value) const {
+    return get<T>(name).value_or(default_value);
+  }
+
+  std::size_t size() const { return entries_.size(); }
+  entry_range entries() const {
+    return {entries_.data(), entries_.data() + entries_.size()};
+  }
+
+ private:
+  using entry_vector =
+      std::vector<entry, detail::rebind_alloc<Allocator, entry>>;
+
+  typename entry_vector::const_iterator lower_bound(
+      const std::string_view& name) const {
+    return std::lower_bound(
+        entries_.begin(), entries_.end(), name,
+        [](const entry& e, const std::string_view& key) { return e.name < key; });
+  }
+
+  entry_vector entries_;
+};
+
+using option_index = basic_option_index<>;
+
+// Keeps argc and argv and defers all parsing until it is needed, for tools
+// that only ever look at a few options. The first get, get_multiple or
+// positional access indexes the whole command line into a basic_args, exactly
+// once even if several threads race on it. find instead scans argv only up to
+// the first occurrence of the option and never builds the index. argv must
+// outlive the object.
+template <class Allocator = std::allocator<char>>
+struct basic_lazy_args {
+  basic_lazy_args(const int argc, char** argv,
+                  const Allocator& allocator = Allocator())
+      : basic_lazy_args(argc, argv, parse_options(), allocator) {}
+
+  basic_lazy_args(const int argc, char** argv, const parse_options& options,
+                  const Allocator& allocator = Allocator())
+      : argc_(argc), argv_(argv), options_(options), allocator_(allocator) {}
+
+  // Same as get, stopping at the first occurrence of the option instead of
+  // parsing the whole command line. With response files enabled, the full
+  // index is used since the option may hide in any of them; with env_prefix,
+  // it is used for an option that argv does not have, since the environment
+  // may still provide it.
+  template <class T>
+  std::optional<T> find(const std::string_view& option) const {
+    if (options_.response_files) return parsed().template get<T>(option);
+    if (const auto value = detail::find_first(
+            argc_, argv_, option, options_.negation,
+            detail::short_option_table(options_.short_options))) {
+      return detail::coerce<T>(value->get());
+    }
+    if (!options_.env_prefix.empty()) return parsed().template get<T>(option);
+    return std::nullopt;
+  }
+
+  template <class T>
+  T find(const std::string_view& option, T&& default_value) const {
+    return find<T>(option).value_or(default_value);
+  }
+
+  template <class T>
+  std::optional<T> get(const std::string_view& option) const {
+    return parsed().template get<T>(option);
+  }
+
+  template <class T>
+  T get(const std::string_view& option, T&& default_value) const {
+    return get<T>(option).value_or(default_value);
+  }
+
+  template <class T>
+  std::vector<std::optional<T>> get_multiple(const std::string_view& option) const {
+    return parsed().template get_multiple<T>(option);
+  }
+
+  template <class T>
+  std::vector<T> get_multiple(const std::string_view& option, T&& default_value) const {
+    return parsed().template get_multiple<T>(option,
+                                             std::forward<T>(default_value));
+  }
+
+  template <class T>
+  values_view<T> get_multiple_view(const std::string_view& option) const {
+    return parsed().template get_multiple_view<T>(option);
+  }
+
+  template <class T>
+  std::optional<T> get(const key& option) const {
+    return parsed().template get<T>(option);
+  }
+
+  template <class T>
+  T get(const key& option, T&& default_value) const {
+    return get<T>(option).value_or(default_value);
+  }
+
+  template <class T>
+  std::vector<std::optional<T>> get_multiple(const key& option) const {
+    return parsed().template get_multiple<T>(option);
+  }
+
+  option_slot resolve(const key& option) const {
+    return parsed().resolve(option);
+  }
+
+  template <class T>
+  std::optional<T> get(size_t positional_index) const {
+    return parsed().template get<T>(positional_index);
+  }
+
+  template <class T>
+  T get(size_t positional_index, T&& default_value) const {
+    return get<T>(positional_index).value_or(default_value);
+  }
+
+  const detail::view_vector<Allocator>& positional() const {
+    return parsed().positional();
+  }
+
+  const detail::view_vector<Allocator>& skipped() const {
+    return parsed().skipped();
+  }
+
+  // The fully parsed command line, built on first use.
+  const basic_args<Allocator>& parsed() const {
+    std::call_once(parsed_once_, [this] {
+      parsed_.emplace(argc_, argv_, options_, allocator_);
+    });
+    return *parsed_;
+  }
+
+ private:
+  const int argc_;
+  char** const argv_;
+  const parse_options options_;
+  const Allocator allocator_;
+  mutable std::once_flag parsed_once_;
+  mutable std::optional<basic_args<Allocator>> parsed_;
+};
+
+using lazy_args = basic_lazy_args<>;
+
+namespace detail {
+// Drives a tokenizer over argv for flags::visit, expanding response files
+// like basic_parser does. The files stay mapped until the walk is over, since
+// the option waiting for its value may be named in one.
+template <class Visitor>
+struct visit_walk {
+  template <class Token>
+  void feed(const Token& token, const int depth) {
+    const std::string_view view(token);
+    if (depth > 0 && view.size() > 1 && view[0] == '@' &&
+        !tokens.skipping()) {
+      auto file = std::make_unique<mapped_file>(
+          std::string(view.substr(1)).c_str());
+      if (*file) {
+        auto contents = file->contents();
+        files.push_back(std::move(file));
+        while (const auto item = next_response_token(contents)) {
+          feed(*item, depth - 1);
+        }
+        return;
+      }
+    }
+    tokens.feed(token);
+  }
+
+  tokenizer<Visitor> tokens;
+  std::vector<std::unique_ptr<mapped_file>> files;
+};
+}  // namespace detail
+
+// Reports every option, positional argument and skipped token of argv to the
+// visitor in command line order, with the rules of flags::args, and builds
+// nothing: no table, no vectors, no allocation unless a response file is
+// expanded. The visitor needs the three members of a stream_parser visitor
+// and is inlined into the tokenizer, so a visit costs about as much as a
+// hand-written loop over argv. The names and values are views into argv.
+// Every option is reported once per occurrence, so there is no "first value"
+// or precedence; the environment (parse_options::env_prefix) is not read for
+// the same reason.
+//
+//   flags::visit(argc, argv, forwarder);
+template <class Visitor>
+void visit(const int argc, char** argv, Visitor& visitor,
+           const parse_options& options = parse_options()) {
+  detail::visit_walk<Visitor> walk{
+      detail::tokenizer<Visitor>(
+          visitor, options.negation,
+          detail::short_option_table(options.short_options)),
+      {}};
+  const int depth =
+      options.response_files ? options.max_response_file_depth : 0;
+  for (int i = 1; i < argc; ++i) {
+    if (depth > 0 && argv[i][0] == '@') {
+      walk.feed(argv[i], depth);
+    } else {
+      walk.tokens.feed(argv[i]);
+    }
+  }
+  walk.tokens.finish();
+}
+
+// Parses a command line that arrives in chunks, such as one read from a
+// socket or a large generated file, without ever holding all of it. Each chunk
+// is split into tokens with the rules of response files (see
+// detail::next_response_token) and run through the same tokenizer as argv, so
+// a token or a quoted value may straddle any number of chunks. Complete
+// options, positional arguments and skipped tokens are reported to the
+// visitor, as for detail::tokenizer, as soon as they are known:
+//
+//   struct printer {
+//     void on_option(std::string_view name,
+//                    const std::optional<std::string_view>& value);
+//     void on_positional(std::string_view value);
+//     void on_skipped(std::string_view value);
+//   };
+//
+// The views are only valid during the call; flags::convert<T> turns a value
+// into a T. Only the token that straddles the end of a chunk and the name of
+// an option waiting for its value are copied, so memory is bounded by the
+// longest token. The negation and short_options of the parse_options apply;
+// response files and the environment do not.
+template <class Visitor, class Allocator = std::allocator<char>>
+class basic_stream_parser {
+ public:
+  explicit basic_stream_parser(Visitor& visitor,
+                               const parse_options& options = parse_options(),
+                               const Allocator& allocator = Allocator())
+      : tokens_(visitor, options.negation,
+                detail::short_option_table(options.short_options)),
+        carry_(allocator),
+        pending_(allocator) {}
+
+  // Views into the buffers may be held by the tokenizer.
+  basic_stream_parser(const basic_stream_parser&) = delete;
+  basic_stream_parser& operator=(const basic_stream_parser&) = delete;
+
+  // Reports everything that the chunk completes. The chunk may be released
+  // once this returns.
+  void feed(std::string_view chunk) {
+    while (!chunk.empty()) {
+      if (!in_token_) {
+        std::size_t start = 0;
+        while (start < chunk.size() && is_space(chunk[start])) ++start;
+        if (start == chunk.size()) break;
+        chunk.remove_prefix(start);
+        quote_ = chunk[0] == '"' || chunk[0] == '\'' ? chunk[0] : '\0';
+        if (quote_) chunk.remove_prefix(1);
+        in_token_ = true;
+      }
+      const auto end = quote_ ? chunk.find(quote_) : token_end(chunk);
+      if (end == std::string_view::npos) {
+        carry_.append(chunk);
+        break;
+      }
+      const auto token = chunk.substr(0, end);
+      chunk.remove_prefix(quote_ ? end + 1 : end);
+      in_token_ = false;
+      if (carry_.empty()) {
+        tokens_.feed(token);
+      } else {
+        carry_.append(token);
+        emit_carry();
+      }
+    }
+    keep_pending();
+  }
+
+  // Reports the last token, even if its quote was never closed, and the
+  // option still waiting for a value. The parser is then ready for another
+  // command line.
+  void finish() {
+    if (in_token_) emit_carry();
+    tokens_.finish();
+    tokens_.reset();
+    in_token_ = false;
+    quote_ = '\0';
+  }
+
+ private:
+  using buffer = std::basic_string<char, std::char_traits<char>, Allocator>;
+
+  // The whitespace of next_response_token, without its per-byte set search.
+  static bool is_space(const char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+  }
+
+  static std::size_t token_end(const std::string_view& chunk) {
+    for (std::size_t i = 0; i < chunk.size(); ++i) {
+      if (is_space(chunk[i])) return i;
+    }
+    return std::string_view::npos;
+  }
+
+  void emit_carry() {
+    tokens_.feed(std::string_view(carry_));
+    keep_pending();
+    carry_.clear();
+    in_token_ = false;
+  }
+
+  // Copies the name of the waiting option out of a chunk or carry_, both of
+  // which are about to go away.
+  void keep_pending() {
+    const auto name = tokens_.pending();
+    if (!name || name->data() == pending_.data()) return;
+    pending_.assign(name->data(), name->size());
+    tokens_.rebind_pending(pending_);
+  }
+
+  detail::tokenizer<Visitor> tokens_;
+  buffer carry_;
+  buffer pending_;
+  bool in_token_ = false;
+  char quote_ = '\0';
+};
+
+template <class Visitor>
+using stream_parser = basic_stream_parser<Visitor>;
+
+// An immutable parsed command line that owns copies of all of its tokens, so
+// it does not depend on the lifetime of argv. Create it once and hand the
+// std::shared_ptr<const snapshot> to every thread that needs configuration:
+// passing it around copies nothing, and since all of the getters (those of
+// flags::args) are const and lock-free, concurrent reads are safe.
+class snapshot : public args {
+ public:
+  static std::shared_ptr<const snapshot> create(
+      const int argc, const char* const* argv,
+      const parse_options& options = parse_options()) {
+    return std::make_shared<const snapshot>(argc, argv, options);
+  }
+
+  snapshot(const int argc, const char* const* argv,
+           const parse_options& options = parse_options())
+      : args(owning, argc, argv, options) {}
+  snapshot(const snapshot&) = delete;
+  snapshot& operator=(const snapshot&) = delete;
+};
+
+// Reads the image written by basic_args::serialize in place: nothing is
+// parsed or allocated, and the getters are those of flags::args. A
+// supervisor can parse once, write the image to shared memory or a file, and
+// let every worker map it instead of parsing the same command line again:
+//
+//   const std::string image = flags::args(argc, argv, options).serialize();
+//   // ... in the worker, with the image mapped at data:
+//   const flags::serialized_args args(data, size);
+//   if (!args) return;  // not an image, or truncated
+//   const auto threads = args.get<int>("threads", 1);
+//
+// Options are found by binary search over the name table. The image
+// is checked once, by the constructor; an invalid one reads as empty. size
+// may be larger than the image, e.g. a whole shared memory segment. The
+// image must have been written on a machine of the same endianness and
+// outlive the object.
+class serialized_args {
+ public:
+  // The positional arguments or skipped tokens, read in place.
+  class strings {
+   public:
+    struct iterator {
+      using iterator_category = std::input_iterator_tag;
+      using value_type = std::string_view;
+      using difference_type = std::ptrdiff_t;
+      using pointer = void;
+      using reference = std::string_view;
+
+      std::string_view operator*() const { return *args_->string_at(index_); }
+      iterator& operator++() {
+        ++index_;
+        return *this;
+      }
+      bool operator==(const iterator& other) const {
+        return index_ == other.index_;
+      }
+      bool operator!=(const iterator& other) const {
+        return index_ != other.index_;
+      }
+
+      const serialized_args* args_;
+      // Among all of the string entries.
+      std::size_t index_;
+    };
+
+    strings() = default;
+    strings(const serialized_args* args, const std::size_t first,
+            const std::size_t size)
+        : args_(args), first_(first), size_(size) {}
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    std::string_view operator[](const std::size_t index) const {
+      return *args_->string_at(first_ + index);
+    }
+    iterator begin() const { return {args_, first_}; }
+    iterator end() const { return {args_, first_ + size_}; }
+
+   private:
+    const serialized_args* args_ = nullptr;
+    std::size_t first_ = 0;
+    std::size_t size_ = 0;
+  };
+
+  serialized_args(const void* data, const std::size_t size)
+      : data_(static_cast<const char*>(data)) {
+    if (!check(size)) {
+      data_ = nullptr;
+      options_ = values_ = positional_ = skipped_ = 0;
+    }
+  }
+
+  // Whether the image was valid.
+  explicit operator bool() const { return data_ != nullptr; }
+
+  template <class T>
+  std::optional<T> get(const std::string_view& option) const {
+    const auto i = find(option);
+    if (i == npos) return std::nullopt;
+    return detail::coerce<T>(string_at(option_word(i, 2)));
+  }
+
+  template <class T>
+  T get(const std::string_view& option, T&& default_value) const {
+    return get<T>(option).value_or(default_value);
+  }
+
+  template <class T>
+  std::vector<std::optional<T>> get_multiple(
+      const std::string_view& option) const {
+    std::vector<std::optional<T>> coerced;
+    const auto i = find(option);
+    if (i == npos) return coerced;
+    const std::size_t first = option_word(i, 2);
+    const std::size_t count = option_word(i, 3);
+    coerced.reserve(count);
+    for (std::size_t j = 0; j < count; ++j) {
+      coerced.push_back(detail::coerce<T>(string_at(first + j)));
+    }
+    return coerced;
+  }
+
+  template <class T>
+  std::vector<T> get_multiple(const std::string_view& option,
+                              T&& default_value) const {
+    std::vector<T> values;
+    for (auto& item : get_multiple<T>(option)) {
+      values.push_back(item ? std::move(*item) : default_value);
+    }
+    return values;
+  }
+
+  template <class T>
+  std::optional<T> get(size_t positional_index) const {
+    if (positional_index >= positional_) return std::nullopt;
+    return detail::from_string<T>(positional()[positional_index]);
+  }
+
+  template <class T>
+  T get(size_t positional_index, T&& default_value) const {
+    return get<T>(positional_index).value_or(default_value);
+  }
+
+  strings positional() const { return {this, values_, positional_}; }
+  strings skipped() const { return {this, values_ + positional_, skipped_}; }
+
+ private:
+  using format = detail::image_format;
+  static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+  std::size_t word(const std::size_t index) const {
+    return format::load(data_, index);
+  }
+  std::size_t option_word(const std::size_t option,
+                          const std::size_t field) const {
+    return word(format::header_words + format::option_words * option + field);
+  }
+  // The string entries (values, then positional, then skipped) follow the
+  // options.
+  std::size_t string_word(const std::size_t string,
+                          const std::size_t field) const {
+    return word(format::header_words + format::option_words * options_ +
+                format::string_words * string + field);
+  }
+
+  std::string_view name(const std::size_t option) const {
+    return {pool_ + option_word(option, 0), option_word(option, 1)};
+  }
+
+  std::optional<std::string_view> string_at(const std::size_t string) const {
+    const auto offset = string_word(string, 0);
+    if (offset == format::valueless) return std::nullopt;
+    if (offset == format::negated) {
+      return std::string_view(detail::negated_value, 5);
+    }
+    return std::string_view(pool_ + offset, string_word(string, 1));
+  }
+
+  std::size_t find(const std::string_view& option) const {
+    std::size_t low = 0, high = options_;
+    while (low < high) {
+      const std::size_t middle = low + (high - low) / 2;
+      if (format::before(name(middle), option)) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    return low < options_ && name(low) == option ? low : npos;
+  }
+
+  // Every count, offset and size must stay inside the image, so that no
+  // getter needs to check again.
+  bool check(std::size_t size) {
+    if (!data_ || size < format::header_words * sizeof(std::uint32_t) ||
+        word(0) != format::magic || word(1) > size ||
+        word(1) < format::header_words * sizeof(std::uint32_t)) {
+      return false;
+    }
+    size = word(1);
+    options_ = word(2);
+    values_ = word(3);
+    positional_ = word(4);
+    skipped_ = word(5);
+    const std::size_t words = size / sizeof(std::uint32_t);
+    const std::size_t strings = values_ + positional_ + skipped_;
+    if (options_ > words || strings > words ||
+        format::header_words + format::option_words * options_ +
+                format::string_words * strings >
+            words) {
+      return false;
+    }
+    pool_ = data_ + (format::header_words + format::option_words * options_ +
+                     format::string_words * strings) *
+                        sizeof(std::uint32_t);
+    const std::size_t pool_size = static_cast<std::size_t>(data_ + size - pool_);
+    std::size_t next_value = 0;
+    for (std::size_t i = 0; i < options_; ++i) {
+      if (!fits(option_word(i, 0), option_word(i, 1), pool_size) ||
+          option_word(i, 2) != next_value || option_word(i, 3) == 0 ||
+          (i > 0 && !format::before(name(i - 1), name(i)))) {
+        return false;
+      }
+      next_value += option_word(i, 3);
+    }
+    if (next_value != values_) return false;
+    for (std::size_t i = 0; i < strings; ++i) {
+      const auto offset = string_word(i, 0);
+      const bool special =
+          i < values_ &&
+          (offset == format::valueless || offset == format::negated);
+      if (!special && !fits(offset, string_word(i, 1), pool_size)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static bool fits(const std::size_t offset, const std::size_t size,
+                   const std::size_t pool_size) {
+    return offset <= pool_size && size <= pool_size - offset;
+  }
+
+  const char* data_;
+  const char* pool_ = nullptr;
+  std::size_t options_ = 0;
+  std::size_t values_ = 0;
+  std::size_t positional_ = 0;
+  std::size_t skipped_ = 0;
+};
+
+// A configuration file of key=value lines that can be re-read while the
+// program runs, e.g. after a SIGHUP or a file change notification. Each line
+// is read as --key=value by the regular parser; a line without '=' is a
+// valueless flag, and blank lines and lines starting with '#' are ignored.
+// Whitespace around keys and values is trimmed.
+//
+// Every successful (re)load publishes a new immutable snapshot with an atomic
+// pointer swap: readers calling current() never lock and always see either
+// the old or the new snapshot in full. Reclamation is RCU-style: a reader
+// only pins the published pointer for as long as it takes to copy the
+// shared_ptr, and the reload that replaces a snapshot waits for those
+// readers to leave (a grace period) before dropping its own reference. A
+// superseded snapshot is then freed as soon as the last reader's copy goes.
+//
+// config_file does not install any signal handler. Call reload() (or
+// reload_if_changed()) from whichever thread handles the trigger.
+class config_file {
+ public:
+  explicit config_file(std::string path,
+                       const parse_options& options = parse_options())
+      : path_(std::move(path)), options_(options) {
+    if (!reload()) {
+      const char* const argv[] = {"config", nullptr};
+      publish(snapshot::create(1, argv, options_));
+    }
+  }
+  config_file(const config_file&) = delete;
+  config_file& operator=(const config_file&) = delete;
+
+  // The most recently published snapshot, kept alive by the returned pointer
+  // even if a reload replaces it. Lock-free.
+  std::shared_ptr<const snapshot> current() const {
+    for (;;) {
+      const unsigned epoch = epoch_.load();
+      auto& readers = readers_[epoch & 1];
+      readers.fetch_add(1);
+      // If a reload flipped the epoch in between, it may not wait for us.
+      if (epoch_.load() == epoch) {
+        std::shared_ptr<const snapshot> pinned = *current_.load();
+        readers.fetch_sub(1);
+        return pinned;
+      }
+      readers.fetch_sub(1);
+    }
+  }
+
+  // Re-reads the file and publishes the result. Returns false, keeping the
+  // current snapshot, if the file cannot be read.
+  bool reload() {
+    const std::lock_guard<std::mutex> lock(reload_mutex_);
+    return load();
+  }
+
+  // Same as reload, but only if stat reports a change to the file since it
+  // was last read: its modification or status change time (to the
+  // nanosecond), size or inode. Without stat, always reloads.
+  bool reload_if_changed() {
+    const std::lock_guard<std::mutex> lock(reload_mutex_);
+#if __has_include(<sys/mman.h>)
+    const auto stamp = stamp_of(path_.c_str());
+    if (!stamp || stamp == stamp_) return false;
+#endif
+    return load();
+  }
+
+ private:
+#if __has_include(<sys/mman.h>)
+  // What stat tells about the version of a file. A same-size edit within one
+  // second still changes the nanoseconds, and a file replaced by rename has
+  // a new inode.
+  using file_stamp = std::array<long long, 7>;
+
+  static std::optional<file_stamp> stamp_of(const char* path) {
+    struct stat status;
+    if (::stat(path, &status) != 0) return std::nullopt;
+#if defined(__APPLE__)
+    const auto& modified = status.st_mtimespec;
+    const auto& changed = status.st_ctimespec;
+#else
+    const auto& modified = status.st_mtim;
+    const auto& changed = status.st_ctim;
+#endif
+    return file_stamp{static_cast<long long>(modified.tv_sec),
+                      static_cast<long long>(modified.tv_nsec),
+                      static_cast<long long>(changed.tv_sec),
+                      static_cast<long long>(changed.tv_nsec),
+                      static_cast<long long>(status.st_size),
+                      static_cast<long long>(status.st_ino),
+                      static_cast<long long>(status.st_dev)};
+  }
+#endif
+
+  // reload, with reload_mutex_ held. The file is stat'ed before it is read,
+  // so an edit racing with the read leaves a stamp that differs from it.
+  bool load() {
+#if __has_include(<sys/mman.h>)
+    const auto stamp = stamp_of(path_.c_str());
+#endif
+    const detail::mapped_file file(path_.c_str());
+    if (!file) return false;
+    std::vector<std::string> tokens{"config"};
+    auto contents = file.contents();
+    while (!contents.empty()) {
+      const auto end = contents.find('\n');
+      const auto line = trim(contents.substr(0, end));
+      contents.remove_prefix(end == std::string_view::npos ? contents.size()
+                                                           : end + 1);
+      if (line.empty() || line[0] == '#') continue;
+      const auto delimiter = line.find('=');
+      std::string token("--");
+      token += trim(line.substr(0, delimiter));
+      if (delimiter != std::string_view::npos) {
+        token += '=';
+        token += trim(line.substr(delimiter + 1));
+      }
+      tokens.push_back(std::move(token));
+    }
+    std::vector<const char*> argv;
+    argv.reserve(tokens.size() + 1);
+    for (const auto& token : tokens) argv.push_back(token.c_str());
+    argv.push_back(nullptr);
+    publish(snapshot::create(static_cast<int>(tokens.size()), argv.data(),
+                             options_));
+#if __has_include(<sys/mman.h>)
+    stamp_ = stamp;
+#endif
+    return true;
+  }
+
+  static std::string_view trim(std::string_view view) {
+    constexpr std::string_view whitespace = " \t\r\v\f";
+    const auto start = view.find_first_not_of(whitespace);
+    if (start == std::string_view::npos) return {};
+    view.remove_prefix(start);
+    return view.substr(0, view.find_last_not_of(whitespace) + 1);
+  }
+
+  // With reload_mutex_ held, or from the constructor. Readers that may still
+  // be copying the previous snapshot's pointer all entered before the epoch
+  // flip, so once they have left it can be released.
+  void publish(std::shared_ptr<const snapshot> next) {
+    auto published =
+        std::make_unique<const std::shared_ptr<const snapshot>>(std::move(next));
+    latest_.store(published->get());
+    current_.store(published.get());
+    const unsigned epoch = epoch_.fetch_add(1);
+    while (readers_[epoch & 1].load()) std::this_thread::yield();
+    published_ = std::move(published);
+  }
+
+  // The snapshot current() would return, only to be compared: it may already
+  // be freed. Lets cached_flag check for a reload with a single load.
+  const snapshot* latest() const { return latest_.load(); }
+
+  template <class T>
+  friend class cached_flag;
+
+  const std::string path_;
+  const parse_options options_;
+  std::mutex reload_mutex_;
+  // The published snapshot, owned by published_, and the epoch and reader
+  // counts of its grace periods: readers_[epoch & 1] counts the readers that
+  // may be dereferencing current_ since the epoch was last flipped.
+  std::unique_ptr<const std::shared_ptr<const snapshot>> published_;
+  std::atomic<const std::shared_ptr<const snapshot>*> current_{nullptr};
+  std::atomic<const snapshot*> latest_{nullptr};
+  std::atomic<unsigned> epoch_{0};
+  mutable std::array<std::atomic<int>, 2> readers_{};
+#if __has_include(<sys/mman.h>)
+  // The stamp of the file as of the last successful load, if stat succeeded.
+  std::optional<file_stamp> stamp_;
+#endif
+};
+
+// A single reader's typed view of one option of a config_file. The value is
+// coerced into <T> once and kept across reloads for as long as the option's
+// string value is unchanged; only a changed value is coerced again. Checking
+// for a new snapshot is one atomic load. The snapshot last read stays alive
+// until a get sees a newer one. Not meant to be shared between threads: give
+// each reader its own.
+template <class T>
+class cached_flag {
+ public:
+  cached_flag(const config_file& config, std::string option)
+      : config_(config), option_(std::move(option)) {}
+
+  const std::optional<T>& get() {
+    // seen_ keeps its snapshot alive, so its address cannot be reused.
+    if (config_.latest() == seen_.get()) return value_;
+    auto current = config_.current();
+    const auto values = current->get_multiple_view<std::string_view>(option_);
+    std::optional<std::optional<std::string_view>> raw;
+    if (!values.empty()) raw = values[0];
+    // raw_ points into seen_, which is still alive.
+    const bool unchanged = coerced_ && raw == raw_;
+    seen_ = std::move(current);
+    raw_ = raw;
+    if (unchanged) return value_;
+    value_ = raw ? detail::coerce<T>(*raw) : std::nullopt;
+    coerced_ = true;
+    return value_;
+  }
+
+  T get(T&& default_value) { return get().value_or(default_value); }
+
+ private:
+  const config_file& config_;
+  const std::string option_;
+  // The snapshot raw_ points into.
+  std::shared_ptr<const snapshot> seen_;
+  bool coerced_ = false;
+  std::optional<std::optional<std::string_view>> raw_;
+  std::optional<T> value_;
+};
+
+#if __has_include(<memory_resource>)
+namespace pmr {
+// flags::args drawing all of its memory from a std::pmr::memory_resource,
+// e.g. a std::pmr::monotonic_buffer_resource over a stack buffer.
+using args = basic_args<std::pmr::polymorphic_allocator<char>>;
+using option_index = basic_option_index<std::pmr::polymorphic_allocator<char>>;
+using reusable_args =
+    basic_reusable_args<std::pmr::polymorphic_allocator<char>>;
+using args_batch = basic_args_batch<std::pmr::polymorphic_allocator<char>>;
+}  // namespace pmr
+#endif
+
+// The instantiations the flags_precompiled library (src/flags.cc) compiles
+// once: the parser and flags::args itself. Defining FLAGS_EXTERN_TEMPLATES,
+// which linking flags::precompiled does, makes every other translation unit
+// reference them instead of instantiating them again. The conversions
+// (detail::from_string and detail::coerce) are left out: they depend on the
+// flags::converter specializations a translation unit can see, which the
+// library cannot know.
+#define FLAGS_INSTANTIATE(EXTERN)                                    \
+  EXTERN template struct detail::basic_parser<std::allocator<char>>; \
+  EXTERN template struct basic_args<std::allocator<char>>;
+
+#ifdef FLAGS_EXTERN_TEMPLATES
+// The library is built without instrumentation, which changes the layout of
+// the parser and of basic_args.
+#if defined(FLAGS_INSTRUMENTATION)
+#error "FLAGS_INSTRUMENTATION needs flags, not flags::precompiled"
+#endif
+FLAGS_INSTANTIATE(extern)
+#endif
+
+}  // namespace flags
+
+#endif  // FLAGS_ARGS_H_
@@ -0,0 +1,1631 @@
+#ifndef FLAGS_CORE_H_
+#define FLAGS_CORE_H_
+
+// The parts of flags that need neither a hash map nor iostreams: the
+// tokenizer, value conversion and flags::schema_args. See flags.h for the
+// whole library.
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <system_error>
+
+// Whether std::from_chars reads floating point types, which libstdc++ only
+// does since version 11. Otherwise they are read with strtod in the "C"
+// locale. May be predefined to 0 or 1.
+#if !defined(FLAGS_FLOAT_FROM_CHARS)
+#if defined(__cpp_lib_to_chars)
+#define FLAGS_FLOAT_FROM_CHARS 1
+#else
+#define FLAGS_FLOAT_FROM_CHARS 0
+#endif
+#endif
+#if !FLAGS_FLOAT_FROM_CHARS
+#include <cerrno>
+#include <clocale>
+#if defined(__APPLE__)
+#include <xlocale.h>
+#endif
+#endif
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define FLAGS_SCAN_SSE2 1
+#elif defined(__GNUC__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FLAGS_SCAN_NEON 1
+#endif
+
+// Whether the enclosing call is being evaluated at compile time, where
+// std::from_chars cannot be used. Without the builtin, the constexpr
+// conversions are used at run time too.
+#if !defined(FLAGS_CONSTANT_EVALUATED) && defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define FLAGS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+#if !defined(FLAGS_CONSTANT_EVALUATED) && defined(_MSC_VER) && \
+    _MSC_VER >= 1925
+#define FLAGS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#if !defined(FLAGS_CONSTANT_EVALUATED)
+#define FLAGS_CONSTANT_EVALUATED() true
+#endif
+
+namespace flags {
+// Customization point for reading a value of type T. Specialize it with a
+// static from_string(std::string_view) returning std::optional<T> and every
+// getter uses it instead of `std::istream >> T`:
+//   template <>
+//   struct flags::converter<point> {
+//     static std::optional<point> from_string(std::string_view view);
+//   };
+// Specializations are provided for std::chrono::duration, byte_size,
+// ip_address and enums. bool uses flags::detail::default_bools unless
+// converter<bool> is specialized, typically with a bool_vocabulary.
+template <class T, class Enable = void>
+struct converter {};
+
+// A word that reads as a bool, for bool_vocabulary.
+struct bool_word {
+  std::string_view text;
+  bool value;
+};
+
+// A compile-time set of words for reading bools. Each word is keyed on its
+// length and first byte, so a value is compared as a handful of integers and
+// only the word with the same key is compared in full:
+//   template <>
+//   struct flags::converter<bool> {
+//     static constexpr flags::bool_vocabulary words{
+//         {{"on", true}, {"off", false}, {"yes", true}, {"no", false}},
+//         /*ignore_case=*/true};
+//     static std::optional<bool> from_string(std::string_view view) {
+//       return words(view);
+//     }
+//   };
+// A value that is none of the words is `otherwise`: nullopt by default, to
+// reject it.
+template <std::size_t N>
+class bool_vocabulary {
+ public:
+  constexpr bool_vocabulary(const bool_word (&words)[N],
+                            const bool ignore_case = false,
+                            const std::optional<bool> otherwise = std::nullopt)
+      : ignore_case_(ignore_case), otherwise_(otherwise) {
+    for (std::size_t i = 0; i < N; ++i) {
+      words_[i] = words[i];
+      keys_[i] = key(words[i].text);
+    }
+  }
+
+  constexpr std::optional<bool> operator()(const std::string_view value) const {
+    const auto value_key = key(value);
+    for (std::size_t i = 0; i < N; ++i) {
+      if (keys_[i] == value_key && rest_equal(words_[i].text, value)) {
+        return words_[i].value;
+      }
+    }
+    return otherwise_;
+  }
+
+  constexpr const std::array<bool_word, N>& words() const { return words_; }
+
+ private:
+  static constexpr char lower(const char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+  }
+
+  constexpr std::uint32_t key(const std::string_view text) const {
+    const char first = text.empty() ? '\0'
+                       : ignore_case_ ? lower(text[0])
+                                      : text[0];
+    return static_cast<std::uint32_t>(std::min<std::size_t>(text.size(),
+                                                            0xffffff))
+               << 8 |
+           static_cast<unsigned char>(first);
+  }
+
+  // The keys match, so the sizes and first bytes do.
+  constexpr bool rest_equal(const std::string_view word,
+                            const std::string_view value) const {
+    for (std::size_t i = 1; i < word.size(); ++i) {
+      if (ignore_case_ ? lower(word[i]) != lower(value[i])
+                       : word[i] != value[i]) {
+        return false;
+      }
+    }
+    return word.size() == value.size();
+  }
+
+  std::array<bool_word, N> words_{};
+  std::array<std::uint32_t, N> keys_{};
+  bool ignore_case_;
+  std::optional<bool> otherwise_;
+};
+
+namespace detail {
+// The value recorded for --no-foo when parse_options::negation is set. Bools
+// recognize it by address, so it is false whatever the vocabulary; other
+// types read it as "false".
+inline constexpr char negated_value[] = "false";
+
+// A value in the flat value table. A null data pointer is the "no value"
+// sentinel (--flag followed by another option), which keeps the entry at
+// 16 bytes instead of the 24 of an std::optional<std::string_view>. An empty
+// value (--flag "") still points into argv and is distinct from no value.
+struct value_ref {
+  constexpr value_ref() = default;
+  constexpr value_ref(const std::optional<std::string_view>& value)
+      : data(value ? value->data() : nullptr),
+        size(value ? value->size() : 0) {}
+  // The view must point somewhere (into argv), even if it is empty.
+  constexpr explicit value_ref(const std::string_view& value)
+      : data(value.data()), size(value.size()) {}
+
+  constexpr std::optional<std::string_view> get() const {
+    if (!data) return std::nullopt;
+    return std::string_view(data, size);
+  }
+
+  const char* data = nullptr;
+  std::size_t size = 0;
+};
+
+// The length of a NUL-terminated token and the position of its first '='
+// (npos if there is none).
+struct token_scan {
+  std::size_t size;
+  std::size_t delimiter;
+};
+
+// Finds both the terminating NUL and the first '=' of a token in a single
+// pass, 16 bytes at a time where SSE2 or NEON is available, instead of a
+// strlen followed by a second search for '='.
+// The vector loads are aligned to 16 bytes so they never cross into another
+// page, but they do read the bytes surrounding the token; those are masked
+// out, and the sanitizer is told not to report them.
+#if defined(FLAGS_SCAN_SSE2) || defined(FLAGS_SCAN_NEON)
+#if defined(__clang__)
+__attribute__((no_sanitize("address", "thread", "memory")))
+#else
+__attribute__((no_sanitize_address, no_sanitize_thread))
+#endif
+#endif
+inline token_scan scan_token(const char* token) {
+  constexpr auto npos = std::string_view::npos;
+  std::size_t delimiter = npos;
+#if defined(FLAGS_SCAN_SSE2) || defined(FLAGS_SCAN_NEON)
+  const auto address = reinterpret_cast<std::uintptr_t>(token);
+  const char* block =
+      reinterpret_cast<const char*>(address & ~std::uintptr_t(15));
+  // Bytes of the first block that precede the token.
+  unsigned skip = static_cast<unsigned>(address & 15);
+#if defined(FLAGS_SCAN_SSE2)
+  const __m128i nul = _mm_setzero_si128();
+  const __m128i equals = _mm_set1_epi8('=');
+  for (;; block += 16, skip = 0) {
+    const __m128i bytes =
+        _mm_load_si128(reinterpret_cast<const __m128i*>(block));
+    // One bit per byte.
+    const unsigned ends =
+        static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, nul)))
+        >> skip << skip;
+    const unsigned delimiters =
+        static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, equals)))
+        >> skip << skip;
+    const unsigned end = ends ? __builtin_ctz(ends) : 16;
+    if (delimiter == npos && delimiters) {
+      if (const unsigned first = __builtin_ctz(delimiters); first < end) {
+        delimiter = static_cast<std::size_t>(block + first - token);
+      }
+    }
+    if (ends) return {static_cast<std::size_t>(block + end - token), delimiter};
+  }
+#else
+  const uint8x16_t nul = vdupq_n_u8(0);
+  const uint8x16_t equals = vdupq_n_u8('=');
+  // Narrows a byte comparison into a 64 bit mask with four bits per byte.
+  const auto mask = [](const uint8x16_t compared) {
+    return vget_lane_u64(
+        vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(compared), 4)), 0);
+  };
+  for (;; block += 16, skip = 0) {
+    const uint8x16_t bytes =
+        vld1q_u8(reinterpret_cast<const std::uint8_t*>(block));
+    const std::uint64_t ends =
+        mask(vceqq_u8(bytes, nul)) >> (4 * skip) << (4 * skip);
+    const std::uint64_t delimiters =
+        mask(vceqq_u8(bytes, equals)) >> (4 * skip) << (4 * skip);
+    const unsigned end = ends ? __builtin_ctzll(ends) / 4 : 16;
+    if (delimiter == npos && delimiters) {
+      if (const unsigned first = __builtin_ctzll(delimiters) / 4; first < end) {
+        delimiter = static_cast<std::size_t>(block + first - token);
+      }
+    }
+    if (ends) return {static_cast<std::size_t>(block + end - token), delimiter};
+  }
+#endif
+#else
+  std::size_t size = 0;
+  for (; token[size]; ++size) {
+    if (token[size] == '=' && delimiter == npos) delimiter = size;
+  }
+  return {size, delimiter};
+#endif
+}
+
+// The single-letter options that are read the POSIX way: -abc is -a -b -c,
+// and a letter that takes a value takes the rest of its token (-j8, -ofile)
+// or, if that is empty, the next token (-j 8). Two 256-bit sets make every
+// lookup a shift and a mask.
+class short_option_table {
+ public:
+  constexpr short_option_table() = default;
+
+  // Declares the letters of a getopt-style list: a letter followed by ':'
+  // takes a value, so "vxj:o:" declares -v and -x, and -j and -o with values.
+  constexpr explicit short_option_table(const std::string_view letters) {
+    for (std::size_t i = 0; i < letters.size(); ++i) {
+      if (letters[i] == ':') continue;
+      const bool valued = i + 1 < letters.size() && letters[i + 1] == ':';
+      declare(letters[i], valued);
+    }
+  }
+
+  constexpr void declare(const char letter, const bool valued) {
+    set(declared_, letter);
+    if (valued) set(valued_, letter);
+    any_ = true;
+  }
+
+  constexpr bool empty() const { return !any_; }
+  constexpr bool declared(const char letter) const {
+    return test(declared_, letter);
+  }
+  constexpr bool valued(const char letter) const {
+    return test(valued_, letter);
+  }
+
+ private:
+  using bits = std::uint64_t[4];
+
+  static constexpr void set(bits& set, const char letter) {
+    const auto byte = static_cast<unsigned char>(letter);
+    set[byte >> 6] |= std::uint64_t{1} << (byte & 63);
+  }
+  static constexpr bool test(const bits& set, const char letter) {
+    const auto byte = static_cast<unsigned char>(letter);
+    return (set[byte >> 6] >> (byte & 63)) & 1;
+  }
+
+  bits declared_{};
+  bits valued_{};
+  bool any_ = false;
+};
+
+// Non-destructively tokenizes the argv tokens, reporting them to a visitor.
+// * If the token begins with a -, it will be considered an option.
+// * If the token does not begin with a -, it will be considered a value for the
+// previous option. If there was no previous option, it will be considered a
+// positional argument.
+// * Every token after "--" is skipped.
+// * With negation, a valueless --no-foo is the option foo with the
+// negated_value, and does not take the next token as its value.
+// * A token with a single dash whose first letter is in the short option
+// table is a cluster (see short_option_table). Letters without a value are
+// valueless options, and do not take the next token either. A letter
+// followed by '=' takes the rest of the token after it (-j=8, -v=false).
+// The visitor receives on_option(name, value) once per option occurrence,
+// on_positional(value) and on_skipped(value). Names and values are views
+// into the tokens, clustered letters included.
+template <class Visitor>
+struct tokenizer {
+  constexpr explicit tokenizer(Visitor& visitor, const bool negation = false,
+                               const short_option_table& shorts = {})
+      : negation_(negation), shorts_(shorts), visitor_(visitor) {}
+
+  void operator()(const int argc, char** argv) {
+    for (int i = 1; i < argc; ++i) feed(argv[i]);
+    finish();
+  }
+
+  // Advances the state machine by one NUL-terminated token, such as an argv
+  // entry. Its length and '=' are found in a single scan.
+  void feed(const char* token) {
+    const auto scan = scan_token(token);
+    feed(std::string_view(token, scan.size), scan.delimiter);
+  }
+
+  // Advances the state machine by one token. Unlike the NUL-terminated
+  // overload, this one is constexpr.
+  constexpr void feed(const std::string_view& token) {
+    feed(token, !token.empty() && token[0] == '-'
+                    ? token.find('=')
+                    : std::string_view::npos);
+  }
+
+  // If the last token was an option, it needs to be drained.
+  constexpr void finish() { flush(); }
+
+  // Whether a "--" has been seen.
+  constexpr bool skipping() const { return skipping_; }
+
+  // The name of the option waiting for its value, if any. It is a view into
+  // the token that named it.
+  constexpr std::optional<std::string_view> pending() const {
+    return current_option_.get();
+  }
+
+  // Makes the waiting option refer to name instead, an owned copy of
+  // pending() for tokens that do not outlive the feed.
+  constexpr void rebind_pending(const std::string_view& name) {
+    current_option_ = value_ref(name);
+  }
+
+  // Forgets the state of the previous command line without reporting it.
+  constexpr void reset() {
+    current_option_ = value_ref();
+    skipping_ = false;
+  }
+
+ private:
+  // delimiter is the position of the first '=' in token, if it is an option.
+  constexpr void feed(const std::string_view& token,
+                      const std::size_t delimiter) {
+    if (skipping_) {
+      visitor_.on_skipped(token);
+      return;
+    }
+    // If this token is "--", skip it and every token after it.
+    if (token.size() == 2 && token[0] == '-' && token[1] == '-') {
+      flush();
+      skipping_ = true;
+      return;
+    }
+    churn(token, delimiter);
+  }
+
+  // Advance the state machine for the current token.
+  constexpr void churn(const std::string_view& item,
+                       const std::size_t delimiter) {
+    if(item.empty())
+    {
+      on_value(item);
+      return;
+    }
+    item[0] == '-' ? on_option(item, delimiter) : on_value(item);
+  }
+
+  // Consumes the current option if there is one.
+  constexpr void flush() {
+    if (current_option_.data) on_value();
+  }
+
+  constexpr void on_option(const std::string_view& option,
+                           const std::size_t delimiter) {
+    // Consume the current_option and reassign it to the new option while
+    // removing all leading dashes. The dashes always precede the '='.
+    flush();
+    if (!shorts_.empty() && option.size() > 1 && option[1] != '-' &&
+        shorts_.declared(option[1])) {
+      on_cluster(option);
+      return;
+    }
+    std::size_t dashes = 0;
+    while (dashes < option.size() && option[dashes] == '-') ++dashes;
+
+    // Handle a packed argument (--arg_name=value).
+    if (delimiter != std::string_view::npos) {
+      current_option_ = value_ref(option.substr(dashes, delimiter - dashes));
+      on_value(option.substr(delimiter + 1 /* skip '=' */));
+      return;
+    }
+    const auto name = option.substr(dashes);
+    if (negation_ && name.size() > 3 && name.compare(0, 3, "no-") == 0) {
+      visitor_.on_option(name.substr(3),
+                         std::string_view(negated_value, 5));
+      return;
+    }
+    current_option_ = value_ref(name);
+  }
+
+  // Reports every letter of -abc, up to the first one that takes a value.
+  constexpr void on_cluster(const std::string_view& option) {
+    for (std::size_t i = 1; i < option.size(); ++i) {
+      const auto letter = option.substr(i, 1);
+      auto rest = option.substr(i + 1);
+      if (!rest.empty() && rest[0] == '=') {
+        visitor_.on_option(letter, rest.substr(1));
+        return;
+      }
+      if (!shorts_.valued(option[i])) {
+        visitor_.on_option(letter, std::nullopt);
+        continue;
+      }
+      if (rest.empty()) {
+        // -j 8: the next token is the value, as for --jobs 8.
+        current_option_ = value_ref(letter);
+      } else {
+        visitor_.on_option(letter, rest);
+      }
+      return;
+    }
+  }
+
+  constexpr void on_value(
+      const std::optional<std::string_view>& value = std::nullopt) {
+    // If there's not an option preceding the value, it's a positional argument.
+    if (!current_option_.data) {
+      if (value) visitor_.on_positional(*value);
+      return;
+    }
+    // Consume the preceding option and assign its value.
+    visitor_.on_option(*current_option_.get(), value);
+    current_option_ = value_ref();
+  }
+
+  // The option waiting for its value, or the "no value" sentinel.
+  value_ref current_option_;
+  bool skipping_ = false;
+  bool negation_;
+  short_option_table shorts_;
+  Visitor& visitor_;
+};
+
+// Character types are read as characters by `>>`, not as numbers, so they stay
+// on the stream path.
+template <class T>
+constexpr bool is_character_v =
+    std::is_same_v<T, char> || std::is_same_v<T, signed char> ||
+    std::is_same_v<T, unsigned char> || std::is_same_v<T, wchar_t> ||
+    std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>;
+
+template <class T>
+constexpr bool is_from_chars_v =
+    (std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+     !is_character_v<T>) ||
+    std::is_floating_point_v<T>;
+
+template <class T, class = void>
+constexpr bool has_converter_v = false;
+template <class T>
+constexpr bool has_converter_v<
+    T, std::void_t<decltype(converter<T>::from_string(std::string_view()))>> =
+    true;
+
+// The `std::istream >> T` reader for types without a converter. Only
+// flags/stream.h defines it, so that <sstream> is not pulled in otherwise.
+template <class T, class = void>
+struct stream_fallback {};
+
+template <class T, class = void>
+constexpr bool has_stream_fallback_v = false;
+template <class T>
+constexpr bool has_stream_fallback_v<
+    T, std::void_t<decltype(stream_fallback<T>::from_string(
+           std::string_view()))>> = true;
+
+template <class>
+constexpr bool always_false_v = false;
+
+// std::from_chars for a base 10 integer, as a constant expression: an optional
+// '-' for signed types, then the longest run of digits. nullopt if there are
+// no digits or the number does not fit in T.
+template <class T>
+constexpr std::optional<T> parse_integer(const std::string_view view) {
+  using unsigned_type = std::make_unsigned_t<T>;
+  std::size_t i = 0;
+  bool negative = false;
+  if constexpr (std::is_signed_v<T>) {
+    negative = !view.empty() && view[0] == '-';
+    i = negative;
+  }
+  const std::size_t digits = i;
+  const auto limit = static_cast<unsigned_type>(
+      static_cast<unsigned_type>(std::numeric_limits<T>::max()) + negative);
+  unsigned_type value = 0;
+  for (; i < view.size() && view[i] >= '0' && view[i] <= '9'; ++i) {
+    const auto digit = static_cast<unsigned_type>(view[i] - '0');
+    if (value > (limit - digit) / 10) return std::nullopt;
+    value = static_cast<unsigned_type>(value * 10 + digit);
+  }
+  if (i == digits) return std::nullopt;
+  if (!negative) return static_cast<T>(value);
+  if (value == limit) return std::numeric_limits<T>::min();
+  return static_cast<T>(-static_cast<T>(value));
+}
+
+// The result of from_chars_floating, as std::from_chars_result.
+struct floating_result {
+  const char* ptr;
+  std::errc ec;
+};
+
+#if !FLAGS_FLOAT_FROM_CHARS
+// The "C" locale, so that strtod reads '.' whatever the global locale is.
+#if defined(_WIN32)
+inline _locale_t c_locale() {
+  static const _locale_t locale = _create_locale(LC_ALL, "C");
+  return locale;
+}
+inline float strto(const char* text, char** end, float) {
+  return _strtof_l(text, end, c_locale());
+}
+inline double strto(const char* text, char** end, double) {
+  return _strtod_l(text, end, c_locale());
+}
+inline long double strto(const char* text, char** end, long double) {
+  return _strtold_l(text, end, c_locale());
+}
+#else
+inline locale_t c_locale() {
+  static const locale_t locale = newlocale(LC_ALL_MASK, "C", locale_t());
+  return locale;
+}
+inline float strto(const char* text, char** end, float) {
+  return strtof_l(text, end, c_locale());
+}
+inline double strto(const char* text, char** end, double) {
+  return strtod_l(text, end, c_locale());
+}
+inline long double strto(const char* text, char** end, long double) {
+  return strtold_l(text, end, c_locale());
+}
+#endif
+#endif
+
+// std::from_chars for a floating point type in the general format. Without
+// FLAGS_FLOAT_FROM_CHARS, strtod reads a NUL-terminated copy instead, kept to
+// what std::from_chars accepts: no leading whitespace or '+', no hexadecimal
+// floats, and only a result that overflows or underflows to zero is out of
+// range.
+template <class T>
+floating_result from_chars_floating(const char* first, const char* last,
+                                    T& value) {
+#if FLAGS_FLOAT_FROM_CHARS
+  const auto [ptr, ec] = std::from_chars(first, last, value);
+  return {ptr, ec};
+#else
+  const std::string_view view(first, last - first);
+  const std::size_t sign = !view.empty() && view[0] == '-';
+  if (view.size() == sign || std::strchr(" \t\n\v\f\r+", view[sign])) {
+    return {first, std::errc::invalid_argument};
+  }
+  // "0x1p3" is read as 0.
+  std::size_t length = view.size();
+  if (length > sign + 1 && view[sign] == '0' &&
+      (view[sign + 1] == 'x' || view[sign + 1] == 'X')) {
+    length = sign + 1;
+  }
+  char small[64];
+  std::string large;
+  char* text = small;
+  if (length < sizeof(small)) {
+    std::memcpy(small, first, length);
+    small[length] = '\0';
+  } else {
+    large.assign(first, length);
+    text = large.data();
+  }
+  char* end = nullptr;
+  errno = 0;
+  const T result = strto(text, &end, T());
+  if (end == text) return {first, std::errc::invalid_argument};
+  if (errno == ERANGE &&
+      (result == 0 || result == std::numeric_limits<T>::infinity() ||
+       result == -std::numeric_limits<T>::infinity())) {
+    return {first + (end - text), std::errc::result_out_of_range};
+  }
+  value = result;
+  return {first + (end - text), std::errc()};
+#endif
+}
+
+// Coerces a single string value into <T>.
+// Integral and floating point types are parsed with std::from_chars (see
+// from_chars_floating for standard libraries without it): no allocation, no
+// locale. To stay compatible with the `>>` path, leading
+// whitespace and a single leading '+' are skipped, and parsing stops at the
+// first character that cannot continue the number. Trailing garbage is then
+// ignored ("12abc" and "12.5" both yield 12 as an int), but a value with no
+// numeric prefix at all ("abc") or one that overflows <T> is rejected.
+// Since the values are already stored as strings, there's no need to use `>>`
+// for strings. Types with a flags::converter use it, and every other type
+// falls back to `std::istream >> T`, which requires flags/stream.h.
+// Integers, bools, string views, enums and constexpr converters can also be
+// read in constant expressions; floating point types cannot.
+template <class T>
+constexpr std::optional<T> from_string(std::string_view view) {
+  if constexpr (has_converter_v<T>) {
+    return converter<T>::from_string(view);
+  } else if constexpr (std::is_same_v<T, std::string_view>) {
+    return view;
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return std::string(view);
+  } else if constexpr (is_from_chars_v<T>) {
+    const auto start = view.find_first_not_of(" \t\n\v\f\r");
+    if (start == std::string_view::npos) return std::nullopt;
+    view.remove_prefix(start);
+    if (view.size() > 1 && view[0] == '+' && view[1] != '-') {
+      view.remove_prefix(1);
+    }
+    T value{};
+    if constexpr (std::is_integral_v<T>) {
+      if (FLAGS_CONSTANT_EVALUATED()) return parse_integer<T>(view);
+      const auto [end, error] =
+          std::from_chars(view.data(), view.data() + view.size(), value);
+      if (error != std::errc()) return std::nullopt;
+    } else {
+      const auto [end, error] = from_chars_floating(
+          view.data(), view.data() + view.size(), value);
+      if (error != std::errc()) return std::nullopt;
+    }
+    return value;
+  } else if constexpr (has_stream_fallback_v<T>) {
+    return stream_fallback<T>::from_string(view);
+  } else {
+    static_assert(always_false_v<T>,
+                  "no flags::converter for this type: specialize one, or "
+                  "include flags/stream.h (or flags.h) to read it with >>");
+    return std::nullopt;
+  }
+}
+
+// Special case for booleans: if the value is any of the below, the option will
+// be considered falsy. Otherwise, it will be considered truthy just for being
+// present.
+constexpr std::array<const char*, 5> falsities{{"0", "n", "no", "f", "false"}};
+
+// The falsities, case-sensitively, with every other value true.
+inline constexpr auto default_bools = [] {
+  bool_word words[falsities.size()]{};
+  for (std::size_t i = 0; i < falsities.size(); ++i) {
+    words[i] = {falsities[i], false};
+  }
+  return bool_vocabulary(words, false, true);
+}();
+
+// Coerces the value of an option that is known to be present into <T>.
+// Booleans are true when valueless (--verbose) and false when negated
+// (--no-verbose); other values go through converter<bool> if it is
+// specialized, else default_bools. Every other type is nullopt when
+// valueless.
+template <class T>
+constexpr std::optional<T> coerce(
+    const std::optional<std::string_view>& value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    if (!value) return true;
+    if (value->data() == negated_value) return false;
+    // T, not bool, so that converter<bool> may be specialized after this.
+    if constexpr (has_converter_v<T>) {
+      return converter<T>::from_string(*value);
+    } else {
+      return default_bools(*value);
+    }
+  } else {
+    if (value) return from_string<T>(*value);
+    return std::nullopt;
+  }
+}
+
+// Coerces the string value of the given positional index into <T>.
+// If the value cannot be properly parsed or the key does not exist, returns
+// nullopt.
+template <class T, class Allocator>
+std::optional<T> get(
+    const std::vector<std::string_view, Allocator>& positional_arguments,
+                     size_t positional_index) {
+  if (positional_index < positional_arguments.size()) {
+    return from_string<T>(positional_arguments[positional_index]);
+  }
+  return std::nullopt;
+}
+
+// A visitor that records the first value of one option and nothing else.
+struct first_occurrence {
+  void on_option(const std::string_view& name,
+                 const std::optional<std::string_view>& value) {
+    if (!found && name == option) found = value_ref(value);
+  }
+  void on_positional(const std::string_view&) {}
+  void on_skipped(const std::string_view&) {}
+
+  std::string_view option;
+  std::optional<value_ref> found;
+};
+
+// Scans argv only up to the first occurrence of option and returns its value,
+// or nullopt if it was not passed. Nothing is stored. negation and shorts are
+// those of the tokenizer the full parse would use.
+inline std::optional<value_ref> find_first(
+    const int argc, char** argv, const std::string_view& option,
+    const bool negation = false, const short_option_table& shorts = {}) {
+  first_occurrence visitor{option, std::nullopt};
+  tokenizer<first_occurrence> tokens(visitor, negation, shorts);
+  for (int i = 1; i < argc && !visitor.found; ++i) tokens.feed(argv[i]);
+  // If the last token was the option, it needs to be drained.
+  if (!visitor.found) tokens.finish();
+  return visitor.found;
+}
+
+// A vector of at most N items kept in place, usable in constant expressions.
+template <class T, std::size_t N>
+class fixed_vector {
+ public:
+  constexpr std::size_t size() const { return size_; }
+  constexpr bool empty() const { return size_ == 0; }
+  constexpr const T& operator[](const std::size_t i) const { return items_[i]; }
+  constexpr const T* begin() const { return items_.data(); }
+  constexpr const T* end() const { return items_.data() + size_; }
+
+  // The caller guarantees that there is room.
+  constexpr void push_back(const T& item) { items_[size_++] = item; }
+
+ private:
+  std::array<T, N> items_{};
+  std::size_t size_ = 0;
+};
+
+// Returns the indices of names in lexicographic order of the names they refer
+// to. Insertion sort, since std::sort is not constexpr in C++17. Throws
+// std::invalid_argument (aborts without exceptions) if two names are equal,
+// which makes a duplicate a compile error where the result is a constant
+// expression.
+template <std::size_t N>
+constexpr std::array<std::size_t, N> sorted_order(
+    const std::array<std::string_view, N>& names) {
+  std::array<std::size_t, N> order{};
+  for (std::size_t i = 0; i < N; ++i) {
+    std::size_t j = i;
+    for (; j > 0 && names[i] < names[order[j - 1]]; --j) {
+      order[j] = order[j - 1];
+    }
+    order[j] = i;
+  }
+  for (std::size_t i = 1; i < N; ++i) {
+    if (names[order[i - 1]] == names[order[i]]) {
+#if defined(__cpp_exceptions)
+      throw std::invalid_argument("flags::schema: duplicate flag name");
+#else
+      std::abort();
+#endif
+    }
+  }
+  return order;
+}
+
+}  // namespace detail
+
+// Converts the value of an option that was passed into <T> with the rules of
+// args::get, for code that receives the raw values from a tokenizer: a bool
+// is true if valueless and false if negated, other types are nullopt if
+// valueless.
+template <class T>
+constexpr std::optional<T> convert(
+    const std::optional<std::string_view>& value) {
+  return detail::coerce<T>(value);
+}
+
+// A declared flag that was passed but whose value could not be coerced into
+// the flag's type, or was outside the flag's range. value is nullopt if the
+// flag was passed without a value.
+struct conversion_error {
+  enum reason_type { invalid, out_of_range };
+
+  std::string_view option;
+  std::optional<std::string_view> value;
+  reason_type reason = invalid;
+};
+
+namespace detail {
+// The range a flag's value must fall in. Only numbers can have one.
+template <class T, class = void>
+struct flag_bounds {
+  static constexpr bool available = false;
+};
+template <class T>
+struct flag_bounds<T, std::enable_if_t<std::is_arithmetic_v<T>>> {
+  static constexpr bool available = true;
+  constexpr bool contains(const T& value) const {
+    return !set || (!(value < low) && !(high < value));
+  }
+
+  bool set = false;
+  T low{};
+  T high{};
+};
+
+// How help() shows the value of a flag of type T, e.g. "int". Defined with
+// the converters below.
+template <class T>
+std::string type_label();
+}  // namespace detail
+
+// A flag declared in a schema: its name on the command line, the type its
+// value is coerced into, and what schema_args checks and help() shows. The
+// setters are constexpr and return a copy, so they chain inside a constexpr
+// schema:
+//   flags::flag<int>("threads").help("worker threads").range(1, 64)
+template <class T>
+struct flag {
+  using value_type = T;
+  constexpr explicit flag(const std::string_view flag_name) : name(flag_name) {}
+
+  constexpr flag help(const std::string_view text) const {
+    flag copy = *this;
+    copy.description = text;
+    return copy;
+  }
+
+  // schema_args reports the flag in missing() if it is not passed.
+  constexpr flag required() const {
+    flag copy = *this;
+    copy.is_required = true;
+    return copy;
+  }
+
+  // schema_args rejects values outside [low, high] like invalid ones.
+  constexpr flag range(const T low, const T high) const {
+    static_assert(detail::flag_bounds<T>::available,
+                  "flags::flag::range is only available for numbers");
+    flag copy = *this;
+    copy.bounds.set = true;
+    copy.bounds.low = low;
+    copy.bounds.high = high;
+    return copy;
+  }
+
+  std::string_view name;
+  std::string_view description;
+  bool is_required = false;
+  detail::flag_bounds<T> bounds;
+};
+
+// The full set of flags a program accepts, known at compile time. The names
+// are kept in a sorted static table, so finding a flag is a constexpr binary
+// search instead of a hash, and every flag owns a fixed slot whose index can
+// be used as a template argument. Names must be unique: a duplicate is a
+// compile error in a constexpr schema and throws std::invalid_argument
+// otherwise. Since the whole
+// table is built by the compiler, declaring hundreds of flags costs nothing
+// at startup.
+// Flags with one-letter names are also short options: bools can be clustered
+// (-vx) and the others take an attached value (-j8) or the next token (-j 8).
+//
+//   constexpr flags::schema options(flags::flag<int>("threads"),
+//                                   flags::flag<bool>("verbose"));
+//   const flags::schema_args args(options, argc, argv);
+//   args.get<options.index_of("threads")>();  // const std::optional<int>&
+template <class... Ts>
+struct schema {
+  static constexpr std::size_t size = sizeof...(Ts);
+  // Returned by index_of for names that are not part of the schema.
+  static constexpr std::size_t npos = size;
+  template <std::size_t I>
+  using type = std::tuple_element_t<I, std::tuple<Ts...>>;
+
+  constexpr explicit schema(const flag<Ts>&... flags)
+      : flags_(flags...),
+        names_{{flags.name...}},
+        order_(detail::sorted_order(names_)),
+        shorts_(short_options_of(flags...)) {}
+
+  constexpr std::size_t index_of(const std::string_view name) const {
+    std::size_t low = 0, high = size;
+    while (low < high) {
+      const std::size_t middle = low + (high - low) / 2;
+      if (names_[order_[middle]] < name) {
+        low = middle + 1;
+      } else {
+        high = middle;
+      }
+    }
+    if (low < size && names_[order_[low]] == name) return order_[low];
+    return npos;
+  }
+
+  constexpr std::string_view name(const std::size_t index) const {
+    return names_[index];
+  }
+
+  // The declaration of the flag in slot I.
+  template <std::size_t I>
+  constexpr const flag<type<I>>& declaration() const {
+    return std::get<I>(flags_);
+  }
+
+  // The one-letter flags, for the tokenizer.
+  constexpr const detail::short_option_table& short_options() const {
+    return shorts_;
+  }
+
+  // One line per flag, in declaration order, with the descriptions aligned:
+  //   --threads=<int>  worker threads (1 to 64)
+  //   --name=<string>  service name (required)
+  //   --verbose        log more
+  std::string help() const {
+    std::array<std::string, size> usages;
+    fill_usages(usages, std::index_sequence_for<Ts...>());
+    std::size_t width = 0;
+    for (const auto& usage : usages) width = std::max(width, usage.size());
+    std::string text;
+    append_lines(text, usages, width, std::index_sequence_for<Ts...>());
+    return text;
+  }
+
+ private:
+  template <std::size_t... Is>
+  void fill_usages(std::array<std::string, size>& usages,
+                   std::index_sequence<Is...>) const {
+    ((usages[Is] = usage<Is>()), ...);
+  }
+
+  static constexpr detail::short_option_table short_options_of(
+      const flag<Ts>&... flags) {
+    detail::short_option_table shorts;
+    ((flags.name.size() == 1
+          ? shorts.declare(flags.name[0], !std::is_same_v<Ts, bool>)
+          : void()),
+     ...);
+    return shorts;
+  }
+
+  template <std::size_t I>
+  std::string usage() const {
+    const bool letter = names_[I].size() == 1;
+    std::string usage = letter ? "  -" : "  --";
+    usage += names_[I];
+    if constexpr (!std::is_same_v<type<I>, bool>) {
+      usage += (letter ? " <" : "=<") + detail::type_label<type<I>>() + ">";
+    }
+    return usage;
+  }
+
+  template <std::size_t... Is>
+  void append_lines(std::string& text,
+                    const std::array<std::string, size>& usages,
+                    const std::size_t width,
+                    std::index_sequence<Is...>) const {
+    (append_line<Is>(text, usages[Is], width), ...);
+  }
+
+  template <std::size_t I>
+  void append_line(std::string& text, const std::string& usage,
+                   const std::size_t width) const {
+    const auto& declaration = std::get<I>(flags_);
+    std::string notes;
+    if constexpr (detail::flag_bounds<type<I>>::available) {
+      if (declaration.bounds.set) {
+        notes = number_text(declaration.bounds.low) + " to " +
+                number_text(declaration.bounds.high);
+      }
+    }
+    if (declaration.is_required) {
+      notes += notes.empty() ? "required" : ", required";
+    }
+    if (!notes.empty()) notes = "(" + notes + ")";
+    std::string line = usage;
+    if (!declaration.description.empty() || !notes.empty()) {
+      line.append(width - usage.size() + 2, ' ');
+      line += declaration.description;
+      if (!declaration.description.empty() && !notes.empty()) line += ' ';
+      line += notes;
+    }
+    text += line;
+    text += '\n';
+  }
+
+  template <class T>
+  static std::string number_text(const T value) {
+    if constexpr (std::is_floating_point_v<T>) {
+      char buffer[32];
+      std::snprintf(buffer, sizeof(buffer), "%g", static_cast<double>(value));
+      return buffer;
+    } else if constexpr (std::is_same_v<T, bool>) {
+      return value ? "true" : "false";
+    } else {
+      return std::to_string(value);
+    }
+  }
+
+  std::tuple<flag<Ts>...> flags_;
+  std::array<std::string_view, size> names_;
+  std::array<std::size_t, size> order_;
+  detail::short_option_table shorts_;
+};
+
+template <class... Ts>
+schema(const flag<Ts>&...) -> schema<Ts...>;
+
+// Parses argv against a schema. Every declared flag is stored in its fixed
+// slot, so construction performs no per-option allocation and a lookup is an
+// array index. Options that are not part of the schema have no slot and are
+// listed in unknown().
+// Each declared flag is coerced into its type and checked against its
+// declaration exactly once, during construction. Values that cannot be
+// coerced or are out of range are collected in errors(), and required flags
+// that were not passed in missing().
+template <class... Ts>
+struct schema_args {
+  schema_args(const schema<Ts...>& schema, const int argc, char** argv)
+      : schema_(schema) {
+    detail::tokenizer<schema_args>(*this, false, schema.short_options())(argc,
+                                                                       argv);
+    check_all(std::index_sequence_for<Ts...>());
+  }
+
+  template <std::size_t I>
+  using type = typename schema<Ts...>::template type<I>;
+
+  // The first value of the flag in slot I, coerced following the same rules
+  // as args::get. The conversion already happened during construction.
+  template <std::size_t I>
+  const std::optional<type<I>>& get() const {
+    return std::get<I>(values_);
+  }
+
+  template <std::size_t I>
+  type<I> get(type<I>&& default_value) const {
+    return get<I>().value_or(default_value);
+  }
+
+  // Same as get<I> with the slot looked up by name at runtime. Returns nullopt
+  // if the flag is not part of the schema or its value was out of range.
+  template <class T>
+  std::optional<T> get(const std::string_view& option) const {
+    const auto index = schema_.index_of(option);
+    if (index == schema_.npos || !slots_[index].count ||
+        slots_[index].rejected) {
+      return std::nullopt;
+    }
+    return detail::coerce<T>(slots_[index].value);
+  }
+
+  template <class T>
+  T get(const std::string_view& option, T&& default_value) const {
+    return get<T>(option).value_or(default_value);
+  }
+
+  // How many times the flag in slot I was passed.
+  template <std::size_t I>
+  std::size_t count() const {
+    return slots_[I].count;
+  }
+
+  template <class T>
+  std::optional<T> get(size_t positional_index) const {
+    return detail::get<T>(positional_arguments_, positional_index);
+  }
+
+  template <class T>
+  T get(size_t positional_index, T&& default_value) const {
+    return get<T>(positional_index).value_or(default_value);
+  }
+
+  const std::vector<std::string_view>& positional() const {
+    return positional_arguments_;
+  }
+
+  const std::vector<std::string_view>& skipped() const {
+    return skipped_tokens_;
+  }
+
+  // Every declared flag whose value could not be coerced or was out of
+  // range, in slot order. Its get<I>() is nullopt.
+  const std::vector<conversion_error>& errors() const { return errors_; }
+
+  // Every occurrence of an option that is not part of the schema, in command
+  // line order, such as a misspelled flag.
+  const std::vector<std::string_view>& unknown() const { return unknown_; }
+
+  // The required flags that were not passed, in slot order.
+  const std::vector<std::string_view>& missing() const { return missing_; }
+
+  // Whether the command line passed every check.
+  bool ok() const {
+    return errors_.empty() && unknown_.empty() && missing_.empty();
+  }
+
+ private:
+  friend struct detail::tokenizer<schema_args>;
+
+  template <std::size_t... Is>
+  void check_all(std::index_sequence<Is...>) {
+    (check_slot<Is>(), ...);
+  }
+
+  template <std::size_t I>
+  void check_slot() {
+    const auto& declaration = schema_.template declaration<I>();
+    if (!slots_[I].count) {
+      if (declaration.is_required) missing_.push_back(declaration.name);
+      return;
+    }
+    auto& value = std::get<I>(values_);
+    value = detail::coerce<type<I>>(slots_[I].value);
+    if (!value) {
+      errors_.push_back({declaration.name, slots_[I].value});
+      return;
+    }
+    if constexpr (detail::flag_bounds<type<I>>::available) {
+      if (!declaration.bounds.contains(*value)) {
+        value.reset();
+        slots_[I].rejected = true;
+        errors_.push_back({declaration.name, slots_[I].value,
+                           conversion_error::out_of_range});
+      }
+    }
+  }
+
+  // The first value passed for a flag and how many times it was passed.
+  struct slot {
+    std::optional<std::string_view> value;
+    std::size_t count = 0;
+    // Whether the value was outside the flag's range.
+    bool rejected = false;
+  };
+
+  void on_option(const std::string_view& option,
+                 const std::optional<std::string_view>& value) {
+    const auto index = schema_.index_of(option);
+    if (index == schema_.npos) {
+      unknown_.push_back(option);
+      return;
+    }
+    if (!slots_[index].count++) slots_[index].value = value;
+  }
+  void on_positional(const std::string_view& value) {
+    positional_arguments_.emplace_back(value);
+  }
+  void on_skipped(const std::string_view& value) {
+    skipped_tokens_.emplace_back(value);
+  }
+
+  const schema<Ts...> schema_;
+  std::array<slot, sizeof...(Ts)> slots_{};
+  std::tuple<std::optional<Ts>...> values_;
+  std::vector<std::string_view> positional_arguments_;
+  std::vector<std::string_view> skipped_tokens_;
+  std::vector<conversion_error> errors_;
+  std::vector<std::string_view> unknown_;
+  std::vector<std::string_view> missing_;
+};
+
+// A command line parsed entirely in place, with no hash map and no
+// allocation, so that fixed command lines such as baked-in defaults can be
+// parsed and checked at compile time:
+//   constexpr flags::static_args defaults("firmware", "--baud=9600", "-v");
+//   static_assert(defaults.get<int>("baud") == 9600);
+// The first token is the program name, as in argv. Coercions follow the rules
+// of args::get; in a constant expression they are limited to the types
+// from_string can read there (no floating point). At run time it works like
+// a small flags::args, with linear lookups over at most N - 1 options.
+template <std::size_t N>
+class static_args {
+ public:
+  constexpr explicit static_args(const std::array<std::string_view, N>& tokens) {
+    detail::tokenizer<static_args> tokenizer(*this);
+    for (std::size_t i = 1; i < N; ++i) tokenizer.feed(tokens[i]);
+    tokenizer.finish();
+  }
+
+  template <class... Tokens,
+            class = std::enable_if_t<
+                sizeof...(Tokens) == N &&
+                std::conjunction_v<
+                    std::is_convertible<const Tokens&, std::string_view>...>>>
+  constexpr explicit static_args(const Tokens&... tokens)
+      : static_args(std::array<std::string_view, N>{{tokens...}}) {}
+
+  template <class T>
+  constexpr std::optional<T> get(const std::string_view option) const {
+    for (const auto& entry : options_) {
+      if (entry.name == option) return detail::coerce<T>(entry.value.get());
+    }
+    return std::nullopt;
+  }
+
+  template <class T>
+  constexpr T get(const std::string_view option, T&& default_value) const {
+    return get<T>(option).value_or(default_value);
+  }
+
+  template <class T>
+  constexpr detail::fixed_vector<std::optional<T>, N> get_multiple(
+      const std::string_view option) const {
+    detail::fixed_vector<std::optional<T>, N> values;
+    for (const auto& entry : options_) {
+      if (entry.name == option) {
+        values.push_back(detail::coerce<T>(entry.value.get()));
+      }
+    }
+    return values;
+  }
+
+  // How many times the option was passed.
+  constexpr std::size_t count(const std::string_view option) const {
+    std::size_t count = 0;
+    for (const auto& entry : options_) count += entry.name == option;
+    return count;
+  }
+
+  template <class T>
+  constexpr std::optional<T> get(const std::size_t positional_index) const {
+    if (positional_index < positional_arguments_.size()) {
+      return detail::from_string<T>(positional_arguments_[positional_index]);
+    }
+    return std::nullopt;
+  }
+
+  template <class T>
+  constexpr T get(const std::size_t positional_index,
+                  T&& default_value) const {
+    return get<T>(positional_index).value_or(default_value);
+  }
+
+  constexpr const detail::fixed_vector<std::string_view, N>& positional()
+      const {
+    return positional_arguments_;
+  }
+
+  constexpr const detail::fixed_vector<std::string_view, N>& skipped() const {
+    return skipped_tokens_;
+  }
+
+ private:
+  friend struct detail::tokenizer<static_args>;
+
+  constexpr void on_option(const std::string_view& option,
+                           const std::optional<std::string_view>& value) {
+    options_.push_back({option, detail::value_ref(value)});
+  }
+  constexpr void on_positional(const std::string_view& value) {
+    positional_arguments_.push_back(value);
+  }
+  constexpr void on_skipped(const std::string_view& value) {
+    skipped_tokens_.push_back(value);
+  }
+
+  // std::pair is not assignable in constant expressions before C++20.
+  struct occurrence {
+    std::string_view name;
+    detail::value_ref value;
+  };
+
+  // Every option occurrence in command line order.
+  detail::fixed_vector<occurrence, N> options_;
+  detail::fixed_vector<std::string_view, N> positional_arguments_;
+  detail::fixed_vector<std::string_view, N> skipped_tokens_;
+};
+
+template <class... Tokens>
+static_args(const Tokens&...) -> static_args<sizeof...(Tokens)>;
+template <std::size_t N>
+static_args(const std::array<std::string_view, N>&) -> static_args<N>;
+
+// A number of bytes, read with an optional unit: a bare number or B is bytes,
+// kB, MB, GB, TB and PB are powers of 1000, and KiB, MiB, GiB, TiB and PiB
+// powers of 1024. Units are case-insensitive and fractions are allowed
+// ("1.5GiB"); the result must fit in 64 bits.
+struct byte_size {
+  std::uint64_t bytes = 0;
+};
+
+// An IPv4 (dotted quad) or IPv6 (RFC 4291 text form, with :: and an optional
+// trailing dotted quad) address, without any name resolution.
+struct ip_address {
+  enum family_type { v4, v6 };
+
+  friend bool operator==(const ip_address& a, const ip_address& b) {
+    return a.family == b.family && a.bytes == b.bytes;
+  }
+  friend bool operator!=(const ip_address& a, const ip_address& b) {
+    return !(a == b);
+  }
+
+  family_type family = v4;
+  // In network order. An IPv4 address only uses the first four bytes.
+  std::array<std::uint8_t, 16> bytes{};
+};
+
+// Specialize to let an enum be read by name; otherwise enums are read as
+// their underlying integer.
+//   template <>
+//   struct flags::enum_names<color> {
+//     static constexpr std::array<std::pair<std::string_view, color>, 2>
+//         values{{{"red", color::red}, {"blue", color::blue}}};
+//   };
+template <class E>
+struct enum_names {};
+
+namespace detail {
+inline bool equals_ignoring_case(const std::string_view a,
+                                 const std::string_view b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) ==
+                  std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+// Splits a quantity such as "250ms" or "1.5 GiB" into its number and its
+// unit, which may be separated by spaces.
+struct quantity {
+  double value;
+  std::string_view unit;
+};
+
+inline std::optional<quantity> split_quantity(const std::string_view view) {
+  double value = 0;
+  const auto [end, error] =
+      from_chars_floating(view.data(), view.data() + view.size(), value);
+  if (error != std::errc()) return std::nullopt;
+  std::string_view unit = view.substr(end - view.data());
+  unit.remove_prefix(std::min(unit.find_first_not_of(' '), unit.size()));
+  return quantity{value, unit};
+}
+
+// Casts a value in units of T's ticks to T, rounding integers to the nearest
+// tick. Returns nullopt if it is out of T's range.
+template <class T>
+std::optional<T> round_to(const double value) {
+  if constexpr (std::is_floating_point_v<T>) {
+    return static_cast<T>(value);
+  } else {
+    // The upper bound rounds up to a power of two, so it is exclusive.
+    if (!(value >= static_cast<double>(std::numeric_limits<T>::lowest()) &&
+          value < static_cast<double>(std::numeric_limits<T>::max()))) {
+      return std::nullopt;
+    }
+    return static_cast<T>(value < 0 ? value - 0.5 : value + 0.5);
+  }
+}
+
+// Reads exactly a dotted quad into four bytes.
+inline bool parse_ipv4(std::string_view view, std::uint8_t* bytes) {
+  for (int i = 0; i < 4; ++i) {
+    if (i) {
+      if (view.empty() || view[0] != '.') return false;
+      view.remove_prefix(1);
+    }
+    unsigned octet = 0;
+    const auto [end, error] = std::from_chars(
+        view.data(), view.data() + std::min<std::size_t>(view.size(), 3),
+        octet);
+    if (error != std::errc() || octet > 255) return false;
+    bytes[i] = static_cast<std::uint8_t>(octet);
+    view.remove_prefix(end - view.data());
+  }
+  return view.empty();
+}
+
+// Reads the text form of an IPv6 address into sixteen bytes.
+inline bool parse_ipv6(std::string_view view, std::uint8_t* bytes) {
+  std::array<std::uint16_t, 8> groups{};
+  std::size_t count = 0;
+  // Where the groups elided by "::" go, if there is one.
+  std::size_t gap = groups.size() + 1;
+  if (view.substr(0, 2) == "::") {
+    gap = 0;
+    view.remove_prefix(2);
+  }
+  while (!view.empty()) {
+    if (count == groups.size()) return false;
+    if (count <= 6 && view.find(':') == std::string_view::npos &&
+        view.find('.') != std::string_view::npos) {
+      std::uint8_t quad[4];
+      if (!parse_ipv4(view, quad)) return false;
+      groups[count++] = static_cast<std::uint16_t>(quad[0] << 8 | quad[1]);
+      groups[count++] = static_cast<std::uint16_t>(quad[2] << 8 | quad[3]);
+      break;
+    }
+    unsigned group = 0;
+    const auto [end, error] = std::from_chars(
+        view.data(), view.data() + std::min<std::size_t>(view.size(), 4),
+        group, 16);
+    if (error != std::errc()) return false;
+    groups[count++] = static_cast<std::uint16_t>(group);
+    view.remove_prefix(end - view.data());
+    if (view.empty()) break;
+    if (view[0] != ':' || view.size() == 1) return false;
+    view.remove_prefix(1);
+    if (view[0] == ':') {
+      if (gap <= groups.size()) return false;
+      gap = count;
+      view.remove_prefix(1);
+    }
+  }
+  const bool elided = gap <= groups.size();
+  if (elided ? count == groups.size() : count != groups.size()) return false;
+  const std::size_t tail = elided ? count - gap : 0;
+  for (std::size_t i = 0; i < groups.size(); ++i) {
+    std::uint16_t group = 0;
+    if (!elided || i < gap) {
+      group = groups[i];
+    } else if (i >= groups.size() - tail) {
+      group = groups[gap + i - (groups.size() - tail)];
+    }
+    bytes[2 * i] = static_cast<std::uint8_t>(group >> 8);
+    bytes[2 * i + 1] = static_cast<std::uint8_t>(group & 0xff);
+  }
+  return true;
+}
+
+template <class E, class = void>
+constexpr bool has_enum_names_v = false;
+template <class E>
+constexpr bool has_enum_names_v<E, std::void_t<decltype(enum_names<E>::values)>> =
+    true;
+}  // namespace detail
+
+// Reads a number followed by one of the units ns, us, ms, s, m or min, h and
+// d ("250ms", "1.5h"). A number without a unit is rejected, since its unit
+// would be a guess. Integer durations are rounded to the nearest tick.
+template <class Rep, class Period>
+struct converter<std::chrono::duration<Rep, Period>> {
+  static std::optional<std::chrono::duration<Rep, Period>> from_string(
+      const std::string_view view) {
+    // Each unit as a ratio of seconds.
+    struct unit {
+      std::string_view name;
+      double num;
+      double den;
+    };
+    static constexpr std::array<unit, 8> units{{{"ns", 1, 1e9},
+                                                {"us", 1, 1e6},
+                                                {"ms", 1, 1e3},
+                                                {"s", 1, 1},
+                                                {"m", 60, 1},
+                                                {"min", 60, 1},
+                                                {"h", 3600, 1},
+                                                {"d", 86400, 1}}};
+    const auto quantity = detail::split_quantity(view);
+    if (!quantity) return std::nullopt;
+    const auto it =
+        std::find_if(units.begin(), units.end(),
+                     [&](const unit& u) { return u.name == quantity->unit; });
+    if (it == units.end()) return std::nullopt;
+    const auto ticks = detail::round_to<Rep>(
+        quantity->value * (it->num * static_cast<double>(Period::den)) /
+        (it->den * static_cast<double>(Period::num)));
+    if (!ticks) return std::nullopt;
+    return std::chrono::duration<Rep, Period>(*ticks);
+  }
+};
+
+template <>
+struct converter<byte_size> {
+  static std::optional<byte_size> from_string(const std::string_view view) {
+    struct unit {
+      std::string_view name;
+      std::uint64_t bytes;
+    };
+    static constexpr std::array<unit, 12> units{
+        {{"", 1},
+         {"b", 1},
+         {"kb", 1000},
+         {"mb", 1000 * 1000},
+         {"gb", 1000ull * 1000 * 1000},
+         {"tb", 1000ull * 1000 * 1000 * 1000},
+         {"pb", 1000ull * 1000 * 1000 * 1000 * 1000},
+         {"kib", 1ull << 10},
+         {"mib", 1ull << 20},
+         {"gib", 1ull << 30},
+         {"tib", 1ull << 40},
+         {"pib", 1ull << 50}}};
+    // Whole numbers are read exactly and everything else as a double.
+    std::uint64_t whole = 0;
+    const auto [end, error] =
+        std::from_chars(view.data(), view.data() + view.size(), whole);
+    const auto quantity = detail::split_quantity(view);
+    if (error != std::errc() || !quantity) return std::nullopt;
+    const auto it = std::find_if(units.begin(), units.end(), [&](const unit& u) {
+      return detail::equals_ignoring_case(u.name, quantity->unit);
+    });
+    if (it == units.end()) return std::nullopt;
+    if (end == quantity->unit.data() || *end == ' ') {
+      if (whole > std::numeric_limits<std::uint64_t>::max() / it->bytes) {
+        return std::nullopt;
+      }
+      return byte_size{whole * it->bytes};
+    }
+    const auto bytes = detail::round_to<std::uint64_t>(
+        quantity->value * static_cast<double>(it->bytes));
+    if (!bytes) return std::nullopt;
+    return byte_size{*bytes};
+  }
+};
+
+template <>
+struct converter<ip_address> {
+  static std::optional<ip_address> from_string(const std::string_view view) {
+    ip_address address;
+    if (view.find(':') == std::string_view::npos) {
+      if (!detail::parse_ipv4(view, address.bytes.data())) return std::nullopt;
+    } else {
+      address.family = ip_address::v6;
+      if (!detail::parse_ipv6(view, address.bytes.data())) return std::nullopt;
+    }
+    return address;
+  }
+};
+
+// Enums are read by the names in their enum_names specialization, if there
+// is one, and as their underlying integer otherwise.
+template <class E>
+struct converter<E, std::enable_if_t<std::is_enum_v<E>>> {
+  static constexpr std::optional<E> from_string(const std::string_view view) {
+    if constexpr (detail::has_enum_names_v<E>) {
+      for (const auto& [name, value] : enum_names<E>::values) {
+        if (name == view) return value;
+      }
+      return std::nullopt;
+    } else {
+      using underlying = std::underlying_type_t<E>;
+      using wide = std::conditional_t<std::is_signed_v<underlying>, long long,
+                                      unsigned long long>;
+      const auto value = detail::from_string<wide>(view);
+      if (!value || *value < std::numeric_limits<underlying>::lowest() ||
+          *value > std::numeric_limits<underlying>::max()) {
+        return std::nullopt;
+      }
+      return static_cast<E>(*value);
+    }
+  }
+};
+
+namespace detail {
+template <class T>
+constexpr bool is_duration_v = false;
+template <class Rep, class Period>
+constexpr bool is_duration_v<std::chrono::duration<Rep, Period>> = true;
+
+template <class T>
+std::string type_label() {
+  if constexpr (is_duration_v<T>) {
+    return "duration";
+  } else if constexpr (std::is_same_v<T, byte_size>) {
+    return "size";
+  } else if constexpr (std::is_same_v<T, ip_address>) {
+    return "address";
+  } else if constexpr (has_enum_names_v<T>) {
+    // The names, since nothing else is accepted.
+    std::string label;
+    for (const auto& entry : enum_names<T>::values) {
+      if (!label.empty()) label += '|';
+      label += entry.first;
+    }
+    return label;
+  } else if constexpr (std::is_integral_v<T> && !is_character_v<T>) {
+    return std::is_signed_v<T> ? "int" : "uint";
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return "number";
+  } else if constexpr (std::is_same_v<T, std::string> ||
+                       std::is_same_v<T, std::string_view>) {
+    return "string";
+  } else {
+    return "value";
+  }
+}
+}  // namespace detail
+
+}  // namespace flags
+
+#endif  // FLAGS_CORE_H_
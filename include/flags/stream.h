@@ -0,0 +1,26 @@
+#ifndef FLAGS_STREAM_H_
+#define FLAGS_STREAM_H_
+
+// Reads values of types that have neither a built-in conversion nor a
+// flags::converter with `std::istream >> T`, as flags always did. Included by
+// flags.h; include it next to flags/core.h or flags/args.h if you need it.
+
+#include "core.h"
+
+#include <istream>
+#include <sstream>
+
+namespace flags {
+namespace detail {
+template <class T>
+struct stream_fallback<T, std::void_t<decltype(std::declval<std::istream&>() >>
+                                               std::declval<T&>())>> {
+  static std::optional<T> from_string(const std::string_view view) {
+    if (T value; std::istringstream(std::string(view)) >> value) return value;
+    return std::nullopt;
+  }
+};
+}  // namespace detail
+}  // namespace flags
+
+#endif  // FLAGS_STREAM_H_
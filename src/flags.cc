@@ -0,0 +1,7 @@
+// Explicit instantiations for the flags_precompiled library; see
+// FLAGS_INSTANTIATE in flags/args.h.
+#include "flags.h"
+
+namespace flags {
+FLAGS_INSTANTIATE()
+}  // namespace flags
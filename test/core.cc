@@ -0,0 +1,118 @@
+#include "flags/core.h"
+
+#include <mettle.hpp>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+
+using namespace mettle;
+
+// Replaces the default bool words for this test binary.
+template <>
+struct flags::converter<bool> {
+  static constexpr flags::bool_vocabulary words{
+      {{"on", true}, {"off", false}, {"yes", true}, {"no", false}}, true};
+  static std::optional<bool> from_string(const std::string_view view) {
+    return words(view);
+  }
+};
+
+// flags/core.h on its own: no flags::args, no hash map and no iostreams.
+namespace {
+constexpr flags::schema options(
+    flags::flag<int>("threads"),
+    flags::flag<std::chrono::milliseconds>("timeout"),
+    flags::flag<std::string>("name"),
+    flags::flag<bool>("cache"));
+using options_args =
+    flags::schema_args<int, std::chrono::milliseconds, std::string, bool>;
+
+char program[] = "TEST";
+char threads[] = "--threads=4";
+char timeout[] = "--timeout=2s";
+char name[] = "--name";
+char value[] = "core";
+char cache[] = "--cache=OFF";
+char* argv[] = {program, threads, timeout, name, value, cache, nullptr};
+
+enum class mode { fast, safe };
+
+// Parsed and checked by the compiler.
+constexpr flags::static_args defaults("firmware", "--baud=9600", "--mode",
+                                      "safe", "-v", "--retry=1", "--retry=-2",
+                                      "image.bin", "--", "--ignored");
+static_assert(defaults.get<int>("baud") == 9600);
+static_assert(defaults.get<bool>("v") == true);
+static_assert(defaults.get<bool>("cache", false) == false);
+static_assert(defaults.get<std::string_view>("mode") == "safe");
+static_assert(defaults.count("retry") == 2);
+static_assert(defaults.get_multiple<int>("retry")[1] == -2);
+static_assert(defaults.get<std::string_view>(0) == "image.bin");
+static_assert(defaults.skipped().size() == 1);
+static_assert(defaults.get<std::int16_t>("baud") == 9600);
+static_assert(defaults.get<std::uint16_t>("retry") == 1);
+static_assert(flags::detail::from_string<long long>(" +42x") == 42);
+static_assert(flags::detail::from_string<int>("-2147483648") ==
+              std::numeric_limits<int>::min());
+static_assert(flags::detail::from_string<int>("2147483648") == std::nullopt);
+static_assert(flags::detail::from_string<unsigned>("-1") == std::nullopt);
+}  // namespace
+
+template <>
+struct flags::enum_names<mode> {
+  static constexpr std::array<std::pair<std::string_view, mode>, 2> values{
+      {{"fast", mode::fast}, {"safe", mode::safe}}};
+};
+
+namespace {
+// An enum by name in a constant expression.
+constexpr flags::static_args<2> modes("TEST", "--mode=fast");
+static_assert(*modes.get<mode>("mode") == mode::fast);
+}  // namespace
+
+suite<> core("core header", [](auto& _) {
+  _.test("schema args", []() {
+    const options_args args(options, 6, argv);
+    expect(*args.get<options.index_of("threads")>(), equal_to(4));
+    expect(args.get<options.index_of("timeout")>()->count(), equal_to(2000));
+    expect(*args.get<options.index_of("name")>(), equal_to("core"));
+    expect(*args.get<options.index_of("cache")>(), equal_to(false));
+    expect(args.errors().size(), equal_to(0));
+  });
+
+  _.test("early exit lookup", []() {
+    const auto found = flags::detail::find_first(5, argv, "name");
+    expect(found.has_value(), equal_to(true));
+    expect(*found->get(), equal_to("core"));
+  });
+
+  // The compile-time integer reader agrees with std::from_chars.
+  _.test("constant integers", []() {
+    const std::string_view inputs[] = {
+        "0",     "-0",     "7",     "12abc",  "-15",    "-",     "",
+        "abc",   "32767",  "32768", "-32768", "-32769", "65535", "65536",
+        "-1",    "007",    "1-2"};
+    for (const auto input : inputs) {
+      expect(flags::detail::from_string<short>(input) ==
+                 flags::detail::parse_integer<short>(input),
+             equal_to(true));
+      expect(flags::detail::from_string<unsigned short>(input) ==
+                 flags::detail::parse_integer<unsigned short>(input),
+             equal_to(true));
+    }
+    const flags::static_args<2> runtime(
+        std::array<std::string_view, 2>{{"TEST", "--ratio=0.5"}});
+    expect(runtime.get<int>("ratio"), equal_to(0));
+    expect(*runtime.get<double>("ratio"), equal_to(0.5));
+  });
+
+  _.test("bool converter", []() {
+    expect(*flags::detail::coerce<bool>("Yes"), equal_to(true));
+    expect(flags::detail::coerce<bool>("1"), equal_to(std::nullopt));
+    expect(*flags::detail::coerce<bool>(std::nullopt), equal_to(true));
+  });
+});
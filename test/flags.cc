@@ -1,12 +1,22 @@
 #include "flags.h"
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <mettle.hpp>
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <vector>
 #include <cstring>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
 
 using namespace mettle;
 
@@ -54,6 +64,20 @@ char** initialize_argv(const std::vector<const char*>& args) {
   return argv;
 }
 
+// Writes a file into the working directory, removing it again on destruction.
+struct temporary_file {
+  temporary_file(const char* path, const std::string_view& contents)
+      : path_(path) {
+    std::FILE* file = std::fopen(path, "wb");
+    std::fwrite(contents.data(), 1, contents.size(), file);
+    std::fclose(file);
+  }
+  ~temporary_file() { std::remove(path_); }
+
+ private:
+  const char* path_;
+};
+
 // Cleans up every item within argv, then argv itself.
 void cleanup_argv(char** argv) {
   size_t index = 0;
@@ -62,6 +86,80 @@ void cleanup_argv(char** argv) {
 }
 }  // namespace
 
+#if __has_include(<memory_resource>)
+// Counts the allocations that reach it.
+struct counting_resource : std::pmr::memory_resource {
+  std::size_t allocations = 0;
+
+ private:
+  void* do_allocate(const std::size_t bytes,
+                    const std::size_t alignment) override {
+    ++allocations;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* p, const std::size_t bytes,
+                     const std::size_t alignment) override {
+    std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const
+      noexcept override {
+    return this == &other;
+  }
+};
+#endif
+
+// Records what a stream_parser reports, one line per event.
+struct event_recorder {
+  void on_option(const std::string_view& name,
+                 const std::optional<std::string_view>& value) {
+    events.push_back("option " + std::string(name) +
+                     (value ? "=" + std::string(*value) : ""));
+  }
+  void on_positional(const std::string_view& value) {
+    events.push_back("positional " + std::string(value));
+  }
+  void on_skipped(const std::string_view& value) {
+    events.push_back("skipped " + std::string(value));
+  }
+
+  std::vector<std::string> events;
+};
+
+// Target of the extract test.
+struct server_config {
+  int threads = 0;
+  bool verbose = false;
+  std::string name;
+  double ratio = 0;
+};
+
+// A user type read through flags::converter rather than operator>>.
+struct point {
+  int x;
+  int y;
+};
+
+enum class color { red, blue };
+enum class level : unsigned char {};
+
+template <>
+struct flags::converter<point> {
+  static std::optional<point> from_string(const std::string_view view) {
+    const auto comma = view.find(',');
+    if (comma == std::string_view::npos) return std::nullopt;
+    const auto x = flags::detail::from_string<int>(view.substr(0, comma));
+    const auto y = flags::detail::from_string<int>(view.substr(comma + 1));
+    if (!x || !y) return std::nullopt;
+    return point{*x, *y};
+  }
+};
+
+template <>
+struct flags::enum_names<color> {
+  static constexpr std::array<std::pair<std::string_view, color>, 2> values{
+      {{"red", color::red}, {"blue", color::blue}}};
+};
+
 // Simple fixture for (de)allocating argv and initalizing flags::args.
 struct args_fixture {
   static args_fixture create(const std::initializer_list<const char*> args) {
@@ -73,6 +171,7 @@ struct args_fixture {
   ~args_fixture() { cleanup_argv(argv_); }
 
   size_t argc() const { return argc_; }
+  char** argv_data() const { return argv_; }
   const flags::args& args() const { return args_; }
   std::string argv(const size_t index) const {
     if (index >= argc_) throw std::out_of_range("index larger than argc");
@@ -192,6 +291,78 @@ suite<> flag_parsing("flag parsing", [](auto& _) {
     }
   });
 
+  // Words of equal length and first byte are told apart by the rest.
+  _.test("bool vocabulary", []() {
+    static constexpr flags::bool_vocabulary words(
+        {{"on", true}, {"off", false}, {"of", true}, {"yes", true}}, true);
+    static_assert(*words("OFF") == false);
+    static_assert(*words("of") == true);
+    expect(*words("On"), equal_to(true));
+    expect(*words("yes"), equal_to(true));
+    expect(words("yess"), equal_to(std::nullopt));
+    expect(words(""), equal_to(std::nullopt));
+
+    static constexpr flags::bool_vocabulary exact({{"off", false}}, false, true);
+    expect(*exact("off"), equal_to(false));
+    expect(*exact("Off"), equal_to(true));
+    expect(*flags::detail::default_bools("False"), equal_to(true));
+    expect(*flags::detail::default_bools(""), equal_to(true));
+  });
+
+  // --no-foo is foo=false when negation is enabled.
+  _.test("negation", []() {
+    const auto fixture = args_fixture::create(
+        {"--no-cache", "positional", "--no-color=auto", "--no-", "--no-x"});
+    char** argv = fixture.argv_data();
+    flags::parse_options options;
+    options.negation = true;
+    const flags::args args(fixture.argc(), argv, options);
+    expect(*args.get<bool>("cache"), equal_to(false));
+    expect(*args.get<std::string>("cache"), equal_to("false"));
+    expect(args.get<bool>("no-cache"), equal_to(std::nullopt));
+    expect(args.positional().size(), equal_to(1));
+    expect(*args.get<std::string_view>("no-color"), equal_to("auto"));
+    expect(*args.get<bool>("no-"), equal_to(true));
+    expect(*args.get<bool>("x"), equal_to(false));
+
+    // Without it, --no-cache takes the next token as usual.
+    expect(*fixture.args().get<std::string_view>("no-cache"),
+           equal_to("positional"));
+  });
+
+  _.test("short options", []() {
+    const auto fixture = args_fixture::create(
+        {"-vx", "a", "-j8", "-j", "9", "-vofile", "-x=false", "-name", "b",
+         "-q", "c", "--", "-v"});
+    char** argv = fixture.argv_data();
+    flags::parse_options options;
+    options.short_options = "vxj:o:";
+    const flags::args args(fixture.argc(), argv, options);
+    expect(args.get_multiple<bool>("v").size(), equal_to(2));
+    expect(*args.get<bool>("v"), equal_to(true));
+    expect(*args.get<bool>("x"), equal_to(true));
+    const auto jobs = args.get_multiple<int>("j");
+    expect(jobs.size(), equal_to(2));
+    expect(*jobs[0], equal_to(8));
+    expect(*jobs[1], equal_to(9));
+    expect(*args.get<std::string_view>("o"), equal_to("file"));
+    const auto x = args.get_multiple<bool>("x");
+    expect(x.size(), equal_to(2));
+    expect(*x[1], equal_to(false));
+    // Tokens that do not start with a declared letter are read as before.
+    expect(*args.get<std::string_view>("name"), equal_to("b"));
+    expect(*args.get<std::string_view>("q"), equal_to("c"));
+    expect(args.positional().size(), equal_to(1));
+    expect(args.positional()[0], equal_to("a"));
+    expect(args.skipped().size(), equal_to(1));
+    // The letters are views into argv.
+    expect(args.get<std::string_view>("o")->data(), equal_to(argv[6] + 3));
+
+    // Without the list, -vx is a single option.
+    expect(fixture.args().get<std::string_view>("vx").has_value(),
+           equal_to(true));
+  });
+
   // Complex strings are succesfully parsed.
   _.test("string", []() {
     constexpr char LOREM_IPSUM[] =
@@ -208,6 +379,37 @@ suite<> flag_parsing("flag parsing", [](auto& _) {
     expect(*fixture.args().get<std::string>("foo"), equal_to(""));
   });
 
+  // @path tokens are replaced by the tokens of the file, recursively.
+  _.test("response files", [](){
+    const temporary_file nested("flags_test_nested.rsp", "--depth 2\n");
+    const temporary_file file(
+        "flags_test.rsp",
+        "--foo 1\n  --bar='not split'  \"quoted value\"\n"
+        "\t@flags_test_nested.rsp positional -- --skipped\n");
+    const auto fixture = args_fixture::create(
+        {"--before", "@flags_test.rsp", "@missing.rsp", "--after"});
+    char** argv = fixture.argv_data();
+    flags::parse_options options;
+    options.response_files = true;
+    const flags::args args(fixture.argc(), argv, options);
+    expect(*args.get<int>("foo"), equal_to(1));
+    expect(*args.get<std::string_view>("bar"), equal_to("'not"));
+    expect(args.positional().size(), equal_to(3));
+    expect(args.positional()[0], equal_to("split'"));
+    expect(args.positional()[1], equal_to("quoted value"));
+    expect(args.positional()[2], equal_to("positional"));
+    expect(*args.get<int>("depth"), equal_to(2));
+    expect(args.skipped().size(), equal_to(3));
+    expect(args.skipped()[0], equal_to("--skipped"));
+    expect(args.skipped()[1], equal_to("@missing.rsp"));
+    expect(args.skipped()[2], equal_to("--after"));
+
+    // Response files are not expanded unless asked for.
+    expect(fixture.args().get<int>("foo"), equal_to(std::nullopt));
+    expect(*fixture.args().get<std::string_view>("before"),
+           equal_to("@flags_test.rsp"));
+  });
+
   // Multiple values for one flag
   _.test("multiple", [](){
     const auto fixture = args_fixture::create({"--foo", "bar", "--foo", "baz"});
@@ -217,6 +419,41 @@ suite<> flag_parsing("flag parsing", [](auto& _) {
     expect(foo[1].value(), equal_to("baz"));
   });
 
+  // Values of interleaved options keep their command line order.
+  _.test("multiple interleaved", [](){
+    const auto fixture = args_fixture::create(
+        {"--foo", "1", "--bar", "a", "--foo", "--bar", "b", "--foo=3"});
+    const auto foo = fixture.args().get_multiple<int>("foo");
+    expect(foo.size(), equal_to(3));
+    expect(foo[0], equal_to(std::optional<int>(1)));
+    expect(foo[1], equal_to(std::nullopt));
+    expect(foo[2], equal_to(std::optional<int>(3)));
+    const auto bar = fixture.args().get_multiple<std::string_view>("bar");
+    expect(bar.size(), equal_to(2));
+    expect(*bar[0], equal_to("a"));
+    expect(*bar[1], equal_to("b"));
+    expect(fixture.args().get_multiple<int>("baz").size(), equal_to(0));
+  });
+
+  // Views coerce lazily over the parser's storage.
+  _.test("multiple view", [](){
+    const auto fixture = args_fixture::create(
+        {"--include", "a", "--include", "b", "-x", "1", "-x", "no", "-x"});
+    const auto includes =
+        fixture.args().get_multiple_view<std::string_view>("include");
+    expect(includes.size(), equal_to(2));
+    std::vector<std::string_view> seen;
+    for (const auto include : includes) seen.push_back(*include);
+    expect(seen, equal_to(std::vector<std::string_view>{"a", "b"}));
+    const auto x = fixture.args().get_multiple_view<int>("x");
+    expect(x.size(), equal_to(3));
+    expect(*x[0], equal_to(1));
+    expect(x[1], equal_to(std::nullopt));
+    expect(x[2], equal_to(std::nullopt));
+    expect(fixture.args().get_multiple_view<int>("missing").empty(),
+           equal_to(true));
+  });
+
   _.test("multiple with type", [](){
     const auto fixture = args_fixture::create({"-x", "-x", "1", "-x", "2"});
     auto x = fixture.args().get_multiple<int>("x", 0);
@@ -267,6 +504,758 @@ suite<> flag_parsing("flag parsing", [](auto& _) {
     expect(fixture.args().get<double>("foobar"), equal_to(std::nullopt));
   });
 
+  // Numeric prefixes are parsed and trailing garbage is ignored, while values
+  // without a numeric prefix or out of range for the type are rejected.
+  _.test("numeric coercion", []() {
+    const auto fixture = args_fixture::create(
+        {"--garbage", "12abc", "--spaces", "  7", "--plus", "+3", "--neg=-5",
+         "--word", "abc", "--huge", "99999999999999999999", "--char",
+         "xyz", "--exp", "1e3"});
+    expect(*fixture.args().get<int>("garbage"), equal_to(12));
+    expect(*fixture.args().get<int>("spaces"), equal_to(7));
+    expect(*fixture.args().get<int>("plus"), equal_to(3));
+    expect(*fixture.args().get<long>("neg"), equal_to(-5));
+    expect(fixture.args().get<unsigned>("neg"), equal_to(std::nullopt));
+    expect(fixture.args().get<int>("word"), equal_to(std::nullopt));
+    expect(fixture.args().get<double>("word"), equal_to(std::nullopt));
+    expect(fixture.args().get<int>("huge"), equal_to(std::nullopt));
+    expect(*fixture.args().get<char>("char"), equal_to('x'));
+    expect(*fixture.args().get<double>("exp"), equal_to(1000.0));
+    expect(fixture.args().get_multiple<int>("garbage", 0)[0], equal_to(12));
+  });
+
+  // Types with a converter skip operator>>; durations, byte sizes, addresses
+  // and enums have one built in.
+  _.test("converters", []() {
+    using namespace std::chrono_literals;
+    const auto fixture = args_fixture::create(
+        {"--point=3,4", "--bad-point=3", "--timeout=250ms", "--slow=1.5 h",
+         "--bare=30", "--tiny=1ns", "--cache=4GiB", "--disk=1.5kB",
+         "--small=512", "--too-big=17179869184GiB", "--v4=192.168.0.1",
+         "--v6=2001:db8::ff00:42:8329", "--mapped=::ffff:10.0.0.1",
+         "--bad-v4=256.0.0.1", "--bad-v6=1::2::3", "--color=blue",
+         "--level=7"});
+    const auto& args = fixture.args();
+    expect(args.get<point>("point")->y, equal_to(4));
+    expect(args.get<point>("bad-point").has_value(), equal_to(false));
+
+    expect(*args.get<std::chrono::milliseconds>("timeout"), equal_to(250ms));
+    expect(*args.get<std::chrono::nanoseconds>("timeout"), equal_to(250ms));
+    expect(*args.get<std::chrono::minutes>("slow"), equal_to(90min));
+    expect(*args.get<std::chrono::seconds>("timeout"), equal_to(0s));
+    expect(args.get<std::chrono::seconds>("bare"), equal_to(std::nullopt));
+    expect(args.get<std::chrono::duration<double>>("tiny")->count(),
+           equal_to(1e-9));
+
+    expect(args.get<flags::byte_size>("cache")->bytes,
+           equal_to(4ull << 30));
+    expect(args.get<flags::byte_size>("disk")->bytes, equal_to(1500u));
+    expect(args.get<flags::byte_size>("small")->bytes, equal_to(512u));
+    expect(args.get<flags::byte_size>("too-big").has_value(), equal_to(false));
+    expect(args.get<flags::byte_size>("point").has_value(), equal_to(false));
+
+    const auto v4 = *args.get<flags::ip_address>("v4");
+    expect(v4.family, equal_to(flags::ip_address::v4));
+    expect(v4.bytes[0], equal_to(192));
+    expect(v4.bytes[3], equal_to(1));
+    const auto v6 = *args.get<flags::ip_address>("v6");
+    expect(v6.family, equal_to(flags::ip_address::v6));
+    expect(v6.bytes[3], equal_to(0xb8));
+    expect(v6.bytes[4], equal_to(0));
+    expect(v6.bytes[10], equal_to(0xff));
+    expect(v6.bytes[11], equal_to(0));
+    expect(v6.bytes[13], equal_to(0x42));
+    expect(v6.bytes[15], equal_to(0x29));
+    const auto mapped = *args.get<flags::ip_address>("mapped");
+    expect(mapped.bytes[10], equal_to(0xff));
+    expect(mapped.bytes[12], equal_to(10));
+    expect(mapped.bytes[15], equal_to(1));
+    expect(args.get<flags::ip_address>("bad-v4").has_value(), equal_to(false));
+    expect(args.get<flags::ip_address>("bad-v6").has_value(), equal_to(false));
+
+    expect(*args.get<color>("color") == color::blue, equal_to(true));
+    expect(args.get<color>("level").has_value(), equal_to(false));
+    expect(static_cast<int>(*args.get<level>("level")), equal_to(7));
+    expect(args.get<level>("too-big").has_value(), equal_to(false));
+  });
+
+#if __has_include(<memory_resource>)
+  // The whole parse fits in a stack buffer: the upstream resource throws if
+  // anything reaches past it.
+  _.test("arena allocation", []() {
+    const auto fixture = args_fixture::create(
+        {"positional", "--foo", "1", "--foo", "2", "--bar", "--", "baz"});
+    char** argv = fixture.argv_data();
+    std::array<std::byte, 4096> buffer;
+    std::pmr::monotonic_buffer_resource arena(
+        buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+    const flags::pmr::args args(fixture.argc(), argv, &arena);
+    expect(args.get_multiple<int>("foo", 0).size(), equal_to(2));
+    expect(*args.get<int>("foo"), equal_to(1));
+    expect(*args.get<bool>("bar"), equal_to(true));
+    expect(args.positional().size(), equal_to(1));
+    expect(args.skipped().size(), equal_to(1));
+  });
+
+  // The copy of the tokens comes from the arena too.
+  _.test("owning arena", []() {
+    std::array<std::byte, 4096> buffer;
+    std::pmr::monotonic_buffer_resource arena(
+        buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+    std::optional<flags::pmr::args> args;
+    {
+      const std::vector<std::string_view> tokens{"TEST", "--foo=1", "bar"};
+      args.emplace(flags::owning, tokens, &arena);
+    }
+    expect(*args->get<int>("foo"), equal_to(1));
+    expect(args->positional()[0], equal_to("bar"));
+  });
+
+  // Once it has seen a command line, a reusable args parses another of the
+  // same shape without allocating.
+  _.test("reusable", []() {
+    counting_resource counter;
+    flags::pmr::reusable_args args(&counter);
+    const auto first = args_fixture::create(
+        {"--foo", "1", "a", "--bar=x", "b", "--foo", "2", "--", "c"});
+    const auto second = args_fixture::create(
+        {"--baz", "3", "d", "--qux=y", "e", "--foo", "4", "--", "f"});
+    args.parse(first.argc(), first.argv_data());
+    expect(args.get_multiple<int>("foo", 0).size(), equal_to(2));
+    const auto allocations = counter.allocations;
+    expect(allocations, greater(0));
+
+    args.parse(second.argc(), second.argv_data());
+    expect(counter.allocations, equal_to(allocations));
+    expect(*args.get<int>("baz"), equal_to(3));
+    expect(*args.get<int>("foo"), equal_to(4));
+    expect(args.get<std::string_view>("bar"), equal_to(std::nullopt));
+    expect(args.positional().size(), equal_to(2));
+    expect(args.positional()[1], equal_to("e"));
+    expect(args.skipped()[0], equal_to("f"));
+
+    args.reset();
+    expect(args.get<int>("foo"), equal_to(std::nullopt));
+    expect(args.positional().size(), equal_to(0));
+  });
+
+  // Every args of a batch, and its tables, come out of one arena.
+  _.test("batch", []() {
+    const auto first = args_fixture::create({"--foo", "1", "a"});
+    const auto second = args_fixture::create({"--foo=2", "--bar"});
+    const flags::command_line lines[] = {
+        {static_cast<int>(first.argc()), first.argv_data()},
+        {static_cast<int>(second.argc()), second.argv_data()}};
+    std::vector<std::byte> buffer(2 * sizeof(flags::pmr::args) + 4096);
+    std::pmr::monotonic_buffer_resource arena(
+        buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+    const flags::pmr::args_batch batch(lines, 2, &arena);
+    expect(batch.size(), equal_to(2));
+    expect(*batch[0].get<int>("foo"), equal_to(1));
+    expect(batch[0].positional()[0], equal_to("a"));
+    expect(*batch[1].get<int>("foo"), equal_to(2));
+    expect(*batch[1].get<bool>("bar"), equal_to(true));
+  });
+
+  // A short command line with no positional arguments is parsed in place.
+  _.test("inline parse", []() {
+    const auto fixture = args_fixture::create(
+        {"--foo", "1", "--foo=2", "--bar", "-baz", "--qux=3"});
+    char** argv = fixture.argv_data();
+    const flags::pmr::args args(fixture.argc(), argv,
+                                std::pmr::null_memory_resource());
+    expect(args.get_multiple<int>("foo", 0)[1], equal_to(2));
+    expect(*args.get<bool>("bar"), equal_to(true));
+    expect(*args.get<bool>("baz"), equal_to(true));
+    expect(*args.get<int>("qux"), equal_to(3));
+    expect(args.get<int>("fo"), equal_to(std::nullopt));
+  });
+#endif
+
+  // Past the inline capacity, options and values move to the heap without
+  // losing any of those seen so far.
+  _.test("many options", []() {
+    std::vector<std::string> tokens;
+    for (int round = 0; round < 3; ++round) {
+      for (int i = 0; i < 40; ++i) {
+        tokens.push_back("--option" + std::to_string(i) + "=" +
+                         std::to_string(round * 100 + i));
+      }
+    }
+    std::vector<const char*> pointers;
+    for (const auto& token : tokens) pointers.push_back(token.c_str());
+    const auto fixture = args_fixture::create(pointers);
+    for (int i = 0; i < 40; ++i) {
+      const auto values =
+          fixture.args().get_multiple<int>("option" + std::to_string(i), -1);
+      expect(values.size(), equal_to(3));
+      expect(values[0], equal_to(i));
+      expect(values[2], equal_to(200 + i));
+    }
+    expect(fixture.args().get<int>("option40"), equal_to(std::nullopt));
+  });
+
+  // The chunks of a parallel batch line up with the command lines.
+  _.test("parallel batch", []() {
+    std::vector<std::vector<std::string>> tokens;
+    std::vector<std::vector<char*>> argvs;
+    for (int i = 0; i < 100; ++i) {
+      tokens.push_back({"TEST", "--index=" + std::to_string(i),
+                        std::to_string(i * 2)});
+    }
+    std::vector<flags::command_line> lines;
+    for (auto& line : tokens) {
+      argvs.emplace_back();
+      for (auto& token : line) argvs.back().push_back(token.data());
+      argvs.back().push_back(nullptr);
+      lines.push_back({3, argvs.back().data()});
+    }
+    for (const std::size_t threads : {1, 3, 8, 200}) {
+      const auto batch =
+          flags::args_batch::parallel(lines.data(), lines.size(), threads);
+      expect(batch.size(), equal_to(100));
+      bool ok = true;
+      for (int i = 0; i < 100; ++i) {
+        ok = ok && batch[i].get<int>("index") == i &&
+             batch[i].get<int>(0) == i * 2;
+      }
+      expect(ok, equal_to(true));
+    }
+    expect(flags::args_batch::parallel(nullptr, 0, 4).size(), equal_to(0));
+  });
+
+  // A command line split at any byte yields the same events as in one chunk,
+  // and no event refers to a chunk that is gone.
+  _.test("stream", []() {
+    const std::string text =
+        "--threads 8\n-vj4  \"quoted value\" --name='a b' --no-cache\t"
+        "--empty= --last -- --skipped 'x y'";
+    flags::parse_options options;
+    options.negation = true;
+    options.short_options = "vj:";
+    const auto parse = [&options, &text](const std::size_t split) {
+      event_recorder recorder;
+      flags::stream_parser<event_recorder> parser(recorder, options);
+      for (std::size_t i = 0; i < text.size(); i += split) {
+        const std::string chunk = text.substr(i, split);
+        parser.feed(chunk);
+      }
+      parser.finish();
+      return recorder.events;
+    };
+    const auto events = parse(text.size());
+    const std::vector<std::string> expected{
+        "option threads=8", "option v", "option j=4",
+        "positional quoted value", "option name='a", "positional b'",
+        "option cache=false", "option empty=", "option last",
+        "skipped --skipped", "skipped x y"};
+    expect(events, equal_to(expected));
+    bool same = true;
+    for (std::size_t split = 1; split < text.size(); ++split) {
+      same = same && parse(split) == events;
+    }
+    expect(same, equal_to(true));
+  });
+
+  _.test("stream finish", []() {
+    event_recorder recorder;
+    flags::stream_parser<event_recorder> parser(recorder);
+    parser.feed("--a 1 --b");
+    expect(recorder.events.size(), equal_to(1));
+    parser.finish();
+    parser.feed("-- x 'unterminated");
+    parser.finish();
+    // The next command line starts afresh.
+    parser.feed("y");
+    parser.finish();
+    expect(recorder.events,
+           equal_to(std::vector<std::string>{"option a=1", "option b",
+                                             "skipped x",
+                                             "skipped unterminated",
+                                             "positional y"}));
+    expect(*flags::convert<int>(std::string_view("12")), equal_to(12));
+    expect(*flags::convert<bool>(std::nullopt), equal_to(true));
+  });
+
+  // visit reports every occurrence in order, with the rules of args.
+  _.test("visit", []() {
+    const auto fixture = args_fixture::create(
+        {"--a", "1", "-vx", "pos", "--no-b", "--a=2", "--", "--c"});
+    char** argv = fixture.argv_data();
+    flags::parse_options options;
+    options.negation = true;
+    options.short_options = "vx";
+    event_recorder recorder;
+    flags::visit(fixture.argc(), argv, recorder, options);
+    expect(recorder.events,
+           equal_to(std::vector<std::string>{
+               "option a=1", "option v", "option x", "positional pos",
+               "option b=false", "option a=2", "skipped --c"}));
+
+    event_recorder plain;
+    flags::visit(fixture.argc(), argv, plain);
+    expect(plain.events.size(), equal_to(5));
+    expect(plain.events[1], equal_to("option vx=pos"));
+  });
+
+  // The option ending a response file takes its value from after the @path.
+  _.test("visit response files", []() {
+    const temporary_file file("flags_test_visit.rsp", "--foo 1\n--last\n");
+    const auto fixture =
+        args_fixture::create({"@flags_test_visit.rsp", "value", "@x.rsp"});
+    char** argv = fixture.argv_data();
+    flags::parse_options options;
+    options.response_files = true;
+    event_recorder recorder;
+    flags::visit(fixture.argc(), argv, recorder, options);
+    expect(recorder.events,
+           equal_to(std::vector<std::string>{"option foo=1",
+                                             "option last=value",
+                                             "positional @x.rsp"}));
+  });
+
+  // The image reads back like the args it came from, wherever it is copied.
+  _.test("serialize", []() {
+    const auto fixture = args_fixture::create(
+        {"--port", "8080", "--verbose", "--define=a=1", "--define", "",
+         "--no-cache", "input", "--", "--rest", "tail"});
+    char** argv = fixture.argv_data();
+    flags::parse_options options;
+    options.negation = true;
+    const flags::args args(fixture.argc(), argv, options);
+    const std::string image = args.serialize();
+    expect(image.empty(), equal_to(false));
+
+    // Off by one byte, to read it unaligned.
+    std::vector<char> copy(image.size() + 1);
+    std::memcpy(copy.data() + 1, image.data(), image.size());
+    const flags::serialized_args read(copy.data() + 1, image.size());
+    expect(static_cast<bool>(read), equal_to(true));
+    expect(*read.get<int>("port"), equal_to(8080));
+    expect(*read.get<bool>("verbose"), equal_to(true));
+    expect(read.get<std::string>("verbose"), equal_to(std::nullopt));
+    expect(*read.get<bool>("cache"), equal_to(false));
+    expect(read.get<int>("missing", 7), equal_to(7));
+    const auto defines = read.get_multiple<std::string>("define");
+    expect(defines.size(), equal_to(2));
+    expect(*defines[0], equal_to("a=1"));
+    expect(*defines[1], equal_to(""));
+    expect(read.get_multiple<int>("port", 0), equal_to(std::vector<int>{8080}));
+    expect(read.get_multiple<int>("missing").size(), equal_to(0));
+    expect(read.positional().size(), equal_to(1));
+    expect(*read.get<std::string>(0), equal_to("input"));
+    expect(read.get<std::string>(1), equal_to(std::nullopt));
+    const std::vector<std::string_view> skipped(read.skipped().begin(),
+                                                read.skipped().end());
+    expect(skipped, equal_to(std::vector<std::string_view>{"--rest", "tail"}));
+
+    // Whatever follows the image, e.g. the rest of a shared memory page, is
+    // ignored.
+    std::string padded = image + std::string(64, 'x');
+    expect(*flags::serialized_args(padded.data(), padded.size())
+                .get<int>("port"),
+           equal_to(8080));
+
+    const flags::args empty(0, nullptr);
+    const auto blank = empty.serialize();
+    expect(static_cast<bool>(flags::serialized_args(blank.data(),
+                                                    blank.size())),
+           equal_to(true));
+  });
+
+  _.test("serialize invalid", []() {
+    const auto fixture = args_fixture::create({"--port", "8080", "x"});
+    const std::string image = fixture.args().serialize();
+    const auto valid = [](const std::string& bytes) {
+      return static_cast<bool>(
+          flags::serialized_args(bytes.data(), bytes.size()));
+    };
+    expect(valid(image), equal_to(true));
+    expect(valid(""), equal_to(false));
+    expect(valid(image.substr(0, image.size() - 1)), equal_to(false));
+    std::string corrupted = image;
+    corrupted[0] = 'X';
+    expect(valid(corrupted), equal_to(false));
+    // A string offset past the pool.
+    corrupted = image;
+    corrupted[6 * 4 + 3] = '\x7f';
+    expect(valid(corrupted), equal_to(false));
+    const flags::serialized_args invalid(nullptr, 0);
+    expect(invalid.get<int>("port"), equal_to(std::nullopt));
+    expect(invalid.positional().size(), equal_to(0));
+  });
+
+  // Keys find the same values as names, before and after the option table
+  // spills into its index.
+  _.test("key", []() {
+    static constexpr flags::key port("port");
+    static_assert(port.hash() == flags::detail::hash_name("port"));
+    static_assert(flags::key("a").hash() != flags::key("b").hash());
+    static_assert(flags::key("verbose_logging").hash() !=
+                  flags::key("verbose_loggind").hash());
+
+    for (const int filler : {0, 100}) {
+      std::vector<std::string> tokens{"TEST", "--port=8080", "--port=9090",
+                                      "--verbose"};
+      for (int i = 0; i < filler; ++i) {
+        tokens.push_back("--filler" + std::to_string(i) + "=" +
+                         std::to_string(i));
+      }
+      const flags::args args(flags::owning, tokens);
+      expect(*args.get<int>(port), equal_to(8080));
+      expect(args.get<int>(flags::key("missing"), 1), equal_to(1));
+      expect(args.get_multiple<int>(port, 0),
+             equal_to(std::vector<int>{8080, 9090}));
+      expect(args.get_multiple<int>(port).size(), equal_to(2));
+      expect(args.get_multiple_view<int>(port).size(), equal_to(2));
+      bool same = true;
+      for (int i = 0; i < filler; ++i) {
+        const auto name = "filler" + std::to_string(i);
+        same = same && args.get<int>(flags::key(name)) == i &&
+               args.get<int>(name) == i;
+      }
+      expect(same, equal_to(true));
+
+      const auto slot = args.resolve(port);
+      expect(slot.passed(), equal_to(true));
+      expect(*slot.get<int>(), equal_to(8080));
+      expect(slot.get_multiple<int>().size(), equal_to(2));
+      expect(*args.resolve(flags::key("verbose")).get<bool>(), equal_to(true));
+      const auto missing = args.resolve(flags::key("missing"));
+      expect(missing.passed(), equal_to(false));
+      expect(missing.get<int>(3), equal_to(3));
+    }
+  });
+
+  // The spilled index is reused, emptied, across command lines.
+  _.test("reusable index", []() {
+    flags::reusable_args args;
+    for (const int options : {40, 100, 20, 100}) {
+      std::vector<std::string> tokens{"TEST"};
+      for (int i = 0; i < options; ++i) {
+        tokens.push_back("--o" + std::to_string(i) + "=" + std::to_string(i));
+      }
+      std::vector<char*> argv;
+      for (auto& token : tokens) argv.push_back(token.data());
+      argv.push_back(nullptr);
+      args.parse(static_cast<int>(tokens.size()), argv.data());
+      bool found = true;
+      for (int i = 0; i < options; ++i) {
+        found = found && args.get<int>("o" + std::to_string(i)) == i;
+      }
+      expect(found, equal_to(true));
+      expect(args.get<int>("o" + std::to_string(options)),
+             equal_to(std::nullopt));
+    }
+  });
+
+  // An owning args outlives the tokens it was built from and can be moved
+  // and copied without them.
+  _.test("owning", []() {
+    std::optional<flags::args> moved;
+    {
+      std::vector<std::string> tokens{"TEST", "--port=8080", "--name",
+                                      "server", "input"};
+      flags::args args(flags::owning, tokens);
+      tokens.assign(tokens.size(), std::string(16, 'x'));
+      moved.emplace(std::move(args));
+    }
+    const flags::args copy = *moved;
+    moved.reset();
+    std::thread([&copy]() {
+      expect(*copy.get<int>("port"), equal_to(8080));
+      expect(*copy.get<std::string_view>("name"), equal_to("server"));
+      expect(copy.positional().size(), equal_to(1));
+      expect(copy.positional()[0], equal_to("input"));
+    }).join();
+
+    const char* argv[] = {"TEST", "--no-cache", nullptr};
+    flags::parse_options options;
+    options.negation = true;
+    const flags::args negated(flags::owning, 2, argv, options);
+    expect(*negated.get<bool>("cache"), equal_to(false));
+  });
+
+  // The vectorized scan agrees with a plain search for every length, '='
+  // position and alignment.
+  _.test("token scanning", [](){
+    std::array<char, 96> buffer;
+    for (std::size_t offset = 0; offset < 16; ++offset) {
+      for (std::size_t size = 0; size < 40; ++size) {
+        for (std::size_t equals = 0; equals <= size + 1; ++equals) {
+          buffer.fill('=');
+          char* token = buffer.data() + offset;
+          std::fill(token, token + size, 'x');
+          if (equals < size) token[equals] = '=';
+          token[size] = '\0';
+          const auto scan = flags::detail::scan_token(token);
+          const auto expected = std::string_view(token).find('=');
+          expect(scan.size, equal_to(size));
+          expect(scan.delimiter, equal_to(expected));
+        }
+      }
+    }
+  });
+
+  // Tokens made only of dashes are options with an empty name.
+  _.test("dashes only", [](){
+    const auto fixture = args_fixture::create({"-", "value", "---"});
+    expect(*fixture.args().get<std::string_view>(""), equal_to("value"));
+    expect(fixture.args().get_multiple<bool>("").size(), equal_to(2));
+  });
+
+  // Lazy args only scan as far as needed until a full index is required.
+  _.test("lazy", [](){
+    const auto fixture = args_fixture::create(
+        {"--help", "--foo", "1", "positional", "--foo=2", "--bar", "--", "x"});
+    char** argv = fixture.argv_data();
+    const flags::lazy_args args(fixture.argc(), argv);
+    expect(*args.find<bool>("help"), equal_to(true));
+    expect(*args.find<int>("foo"), equal_to(1));
+    expect(*args.find<bool>("bar"), equal_to(true));
+    expect(args.find<bool>("x"), equal_to(std::nullopt));
+    expect(args.find<int>("missing", 3), equal_to(3));
+    expect(args.get_multiple<int>("foo", 0).size(), equal_to(2));
+    expect(*args.get<int>("foo"), equal_to(1));
+    expect(args.positional().size(), equal_to(1));
+    expect(args.skipped().size(), equal_to(1));
+    expect(&args.parsed(), equal_to(&args.parsed()));
+
+    // find tokenizes the way the full parse does.
+    const auto negated = args_fixture::create({"--no-verbose", "x"});
+    flags::parse_options options;
+    options.negation = true;
+    const flags::lazy_args lazy(negated.argc(), negated.argv_data(), options);
+    expect(*lazy.find<bool>("verbose"), equal_to(false));
+    expect(lazy.find<bool>("no-verbose"), equal_to(std::nullopt));
+    expect(lazy.find<bool>("verbose"), equal_to(lazy.get<bool>("verbose")));
+
+    const auto clustered = args_fixture::create({"-vj8", "-q"});
+    flags::parse_options shorts;
+    shorts.short_options = "vqj:";
+    const flags::lazy_args letters(clustered.argc(), clustered.argv_data(),
+                                   shorts);
+    expect(*letters.find<int>("j"), equal_to(8));
+    expect(*letters.find<bool>("q"), equal_to(true));
+    expect(letters.find<int>("j"), equal_to(letters.get<int>("j")));
+  });
+
+  // Prefixed environment variables fill in options missing from argv.
+  _.test("environment", [](){
+    std::array<std::string, 7> entries{
+        {"APP_THREADS=4", "APP_NAME=from env", "APP_VERBOSE=", "OTHER=1",
+         "APP_THREADS=9", "APP_=x", "APP_MAX_INFLIGHT=16"}};
+    std::array<char*, 8> environment{};
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+      environment[i] = entries[i].data();
+    }
+    const auto fixture = args_fixture::create({"--name", "from argv"});
+    char** argv = fixture.argv_data();
+    flags::parse_options options;
+    options.env_prefix = "APP_";
+    options.environment = environment.data();
+    const flags::args args(fixture.argc(), argv, options);
+    // Nothing is read from the environment after construction.
+    entries[0][12] = '5';
+    expect(*args.get<int>("threads"), equal_to(4));
+    expect(args.get_multiple<int>("threads").size(), equal_to(1));
+    expect(*args.get<std::string>("name"), equal_to("from argv"));
+    expect(*args.get<std::string_view>("verbose"), equal_to(""));
+    expect(*args.get<int>("max_inflight"), equal_to(16));
+    expect(args.get<int>("other"), equal_to(std::nullopt));
+    expect(args.get<std::string_view>(""), equal_to(std::nullopt));
+
+    // lazy_args::find agrees with get on options only the environment has.
+    const flags::lazy_args lazy(fixture.argc(), argv, options);
+    expect(*lazy.find<std::string>("name"), equal_to("from argv"));
+    expect(*lazy.find<int>("max_inflight"), equal_to(16));
+    expect(lazy.find<int>("max_inflight"),
+           equal_to(lazy.get<int>("max_inflight")));
+    expect(lazy.find<int>("other"), equal_to(std::nullopt));
+  });
+
+#if !defined(_WIN32)
+  _.test("process environment", [](){
+    setenv("FLAGS_TEST_VALUE", "7", 1);
+    const auto fixture = args_fixture::create({});
+    char** argv = fixture.argv_data();
+    flags::parse_options options;
+    options.env_prefix = "FLAGS_TEST_";
+    const flags::args args(fixture.argc(), argv, options);
+    setenv("FLAGS_TEST_VALUE", "8", 1);
+    expect(*args.get<int>("value"), equal_to(7));
+    unsetenv("FLAGS_TEST_VALUE");
+  });
+#endif
+
+  // Snapshots outlive argv and can be read from several threads at once.
+  _.test("snapshot", [](){
+    std::shared_ptr<const flags::snapshot> snapshot;
+    {
+      const auto fixture =
+          args_fixture::create({"--threads", "4", "--name=worker", "file"});
+      snapshot = flags::snapshot::create(static_cast<int>(fixture.argc()),
+                                         fixture.argv_data());
+    }
+    std::vector<std::thread> readers;
+    std::array<bool, 4> correct{};
+    for (std::size_t i = 0; i < correct.size(); ++i) {
+      readers.emplace_back([snapshot, &correct, i] {
+        bool ok = true;
+        for (int j = 0; j < 1000; ++j) {
+          ok = ok && snapshot->get<int>("threads") == 4 &&
+               snapshot->get<std::string_view>("name") == "worker" &&
+               snapshot->get<std::string>(0) == "file";
+        }
+        correct[i] = ok;
+      });
+    }
+    for (auto& reader : readers) reader.join();
+    for (const bool ok : correct) expect(ok, equal_to(true));
+  });
+
+  // Config files are re-read on demand; readers see whole snapshots and
+  // typed values are only coerced again when their string changes.
+  _.test("config file", [](){
+    std::optional<flags::config_file> config;
+    {
+      const temporary_file file(
+          "flags_test.conf",
+          "# comment\n threads = 4 \n\nname=worker\r\nverbose\n");
+      config.emplace("flags_test.conf");
+    }
+    const auto first = config->current();
+    expect(*first->get<int>("threads"), equal_to(4));
+    expect(*first->get<std::string_view>("name"), equal_to("worker"));
+    expect(*first->get<bool>("verbose"), equal_to(true));
+    flags::cached_flag<int> threads(*config, "threads");
+    flags::cached_flag<std::string> name(*config, "name");
+    expect(*threads.get(), equal_to(4));
+    expect(*name.get(), equal_to("worker"));
+
+    expect(config->reload(), equal_to(false));
+    expect(config->current(), equal_to(first));
+
+    std::atomic<bool> done{false};
+    std::thread reader([&config, &done] {
+      while (!done) {
+        const auto threads = config->current()->get<int>("threads");
+        if (!threads || (*threads != 4 && *threads != 6)) std::abort();
+      }
+    });
+    {
+      const temporary_file file("flags_test.conf",
+                                "threads=6\nname=worker\n");
+      for (int i = 0; i < 100; ++i) expect(config->reload(), equal_to(true));
+      // reload already recorded this version of the file.
+      expect(config->reload_if_changed(), equal_to(false));
+    }
+    done = true;
+    reader.join();
+    expect(*config->current()->get<int>("threads"), equal_to(6));
+    expect(config->current()->get<bool>("verbose"), equal_to(std::nullopt));
+    expect(*first->get<int>("threads"), equal_to(4));
+    expect(*threads.get(), equal_to(6));
+    expect(*name.get(), equal_to("worker"));
+  });
+
+  // A superseded snapshot is freed once the last reader lets go of it.
+  _.test("config file reclamation", [](){
+    const temporary_file file("flags_test.conf", "threads=4\n");
+    flags::config_file config("flags_test.conf");
+    flags::cached_flag<int> threads(config, "threads");
+    expect(*threads.get(), equal_to(4));
+    auto held = config.current();
+    const std::weak_ptr<const flags::snapshot> first = held;
+    for (int i = 0; i < 100; ++i) expect(config.reload(), equal_to(true));
+    const std::weak_ptr<const flags::snapshot> older = config.current();
+    expect(config.reload(), equal_to(true));
+    // Neither the config_file nor an idle reader keeps older alive.
+    expect(older.expired(), equal_to(true));
+    expect(first.expired(), equal_to(false));
+    expect(*held->get<int>("threads"), equal_to(4));
+    held.reset();
+    // The cached_flag still pins the first snapshot until it sees a newer one.
+    expect(first.expired(), equal_to(false));
+    expect(*threads.get(), equal_to(4));
+    expect(first.expired(), equal_to(true));
+  });
+
+  // A same-size edit within the same second is still a change.
+  _.test("config file changes", [](){
+    const temporary_file file("flags_test.conf", "max_inflight=8\n");
+    flags::config_file config("flags_test.conf");
+    // The constructor recorded the version it read.
+    expect(config.reload_if_changed(), equal_to(false));
+
+    // Rewritten in place: same inode and size. Sleep past the tick of a
+    // coarse file system clock, well short of a second.
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const temporary_file edit("flags_test.conf", "max_inflight=9\n");
+    expect(config.reload_if_changed(), equal_to(true));
+    expect(config.reload_if_changed(), equal_to(false));
+    expect(*config.current()->get<int>("max_inflight"), equal_to(9));
+  });
+
+  // The index finds options exactly, by prefix, and by unique abbreviation.
+  _.test("option index", [](){
+    const auto fixture = args_fixture::create(
+        {"--storage.cache.size=64", "--storage.cache.ttl", "5",
+         "--storage.path=/tmp", "--verbose", "--version=2", "--v", "--v",
+         "--stor=x"});
+    const flags::option_index index(fixture.args());
+    expect(index.size(), equal_to(7));
+    expect(index.find("storage.path")->name, equal_to("storage.path"));
+    expect(index.find("storage"), equal_to(nullptr));
+    expect(*index.get<int>("storage.cache.size"), equal_to(64));
+    expect(index.get<int>("missing", 3), equal_to(3));
+    expect(index.find("v")->values.size(), equal_to(2));
+
+    const auto cache = index.prefixed("storage.cache.");
+    expect(cache.size(), equal_to(2));
+    expect(cache.begin()[0].name, equal_to("storage.cache.size"));
+    expect(*cache.begin()[1].get<int>(), equal_to(5));
+    expect(index.prefixed("storage.").size(), equal_to(3));
+    expect(index.prefixed("zzz").empty(), equal_to(true));
+    expect(index.prefixed("").size(), equal_to(7));
+
+    expect(index.resolve("verb")->name, equal_to("verbose"));
+    expect(index.resolve("vers")->name, equal_to("version"));
+    expect(index.resolve("ver"), equal_to(nullptr));
+    expect(index.resolve("v")->name, equal_to("v"));
+    expect(index.resolve("stor")->name, equal_to("stor"));
+    expect(index.resolve("storage.p")->name, equal_to("storage.path"));
+    expect(index.resolve("x"), equal_to(nullptr));
+  });
+
+  // extract fills a struct in one pass and reports every problem together.
+  _.test("extract", [](){
+    const auto fixture = args_fixture::create(
+        {"--threads=8", "--verbose", "--ratio=lots", "--typo", "--extra=1"});
+    const auto config = fixture.args().extract(
+        flags::field("threads", &server_config::threads, 1),
+        flags::field("verbose", &server_config::verbose),
+        flags::field("name", &server_config::name, "default"),
+        flags::field("ratio", &server_config::ratio, 0.5));
+    expect(config.value.threads, equal_to(8));
+    expect(config.value.verbose, equal_to(true));
+    expect(config.value.name, equal_to("default"));
+    expect(config.value.ratio, equal_to(0.5));
+    expect(config.ok(), equal_to(false));
+    expect(config.unknown.size(), equal_to(2));
+    expect(config.unknown[0], equal_to("extra"));
+    expect(config.unknown[1], equal_to("typo"));
+    expect(config.errors.size(), equal_to(1));
+    expect(config.errors[0].option, equal_to("ratio"));
+    expect(*config.errors[0].value, equal_to("lots"));
+
+    const auto clean = args_fixture::create({"--name", "foo", "--name", "bar"});
+    const auto named = clean.args().extract(
+        flags::field("name", &server_config::name));
+    expect(named.ok(), equal_to(true));
+    expect(named.value.name, equal_to("foo"));
+  });
+
   _.test("skipped tokens", [](){
     const auto fixture =
         args_fixture::create({"--foo", "--", "bar", "--baz", "1", "2", "3"});
@@ -281,3 +1270,158 @@ suite<> flag_parsing("flag parsing", [](auto& _) {
     expect(skipped.at(4), equal_to("3"));
   });
 });
+
+namespace {
+constexpr flags::schema options(flags::flag<int>("threads"),
+                                flags::flag<bool>("verbose"),
+                                flags::flag<std::string>("name"),
+                                flags::flag<double>("ratio"));
+using options_args = flags::schema_args<int, bool, std::string, double>;
+
+constexpr flags::schema checked(
+    flags::flag<int>("threads").help("worker threads").range(1, 64),
+    flags::flag<std::string>("name").help("service name").required(),
+    flags::flag<color>("color"),
+    flags::flag<double>("ratio").range(0, 0.5).required(),
+    flags::flag<bool>("verbose").help("log more"));
+using checked_args =
+    flags::schema_args<int, std::string, color, double, bool>;
+static_assert(checked.declaration<0>().bounds.high == 64);
+static_assert(checked.declaration<1>().is_required);
+
+constexpr flags::schema letters(flags::flag<bool>("v"), flags::flag<bool>("x"),
+                                flags::flag<int>("j").help("jobs"),
+                                flags::flag<std::string>("output"));
+using letters_args = flags::schema_args<bool, bool, int, std::string>;
+static_assert(letters.short_options().valued('j'));
+static_assert(!letters.short_options().valued('v'));
+static_assert(!letters.short_options().declared('o'));
+}  // namespace
+
+suite<> schema_parsing("schema parsing", [](auto& _) {
+  static_assert(options.index_of("threads") == 0);
+  static_assert(options.index_of("verbose") == 1);
+  static_assert(options.index_of("name") == 2);
+  static_assert(options.index_of("ratio") == 3);
+  static_assert(options.index_of("missing") == options.npos);
+
+  // Two flags cannot share a name, and so a slot. In a constexpr schema this
+  // does not compile.
+  _.test("duplicate names", []() {
+    bool rejected = false;
+    try {
+      const flags::schema duplicated(flags::flag<int>("threads"),
+                                     flags::flag<bool>("verbose"),
+                                     flags::flag<int>("threads"));
+      static_cast<void>(duplicated);
+    } catch (const std::invalid_argument&) {
+      rejected = true;
+    }
+    expect(rejected, equal_to(true));
+  });
+
+  // Declared flags are coerced into their declared types.
+  _.test("typed slots", []() {
+    const auto fixture = args_fixture::create(
+        {"--threads=8", "--verbose", "--name", "foo", "positional"});
+    char** argv = fixture.argv_data();
+    const options_args args(options, fixture.argc(), argv);
+    expect(*args.get<options.index_of("threads")>(), equal_to(8));
+    expect(*args.get<options.index_of("verbose")>(), equal_to(true));
+    expect(*args.get<options.index_of("name")>(), equal_to("foo"));
+    expect(args.get<options.index_of("ratio")>(), equal_to(std::nullopt));
+    expect(args.get<options.index_of("ratio")>(0.5), equal_to(0.5));
+    expect(args.positional().size(), equal_to(1));
+    expect(*args.get<std::string_view>(0), equal_to("positional"));
+  });
+
+  // The first occurrence wins, and unknown options are ignored.
+  _.test("repeated and unknown", []() {
+    const auto fixture = args_fixture::create(
+        {"--threads", "1", "--unknown", "2", "--threads", "3"});
+    char** argv = fixture.argv_data();
+    const options_args args(options, fixture.argc(), argv);
+    expect(*args.get<options.index_of("threads")>(), equal_to(1));
+    expect(args.count<options.index_of("threads")>(), equal_to(2));
+    expect(*args.get<int>("threads"), equal_to(1));
+    expect(args.get<int>("unknown"), equal_to(std::nullopt));
+    expect(args.positional().size(), equal_to(0));
+  });
+
+  // Values are coerced once at construction and malformed ones are reported
+  // together.
+  _.test("conversion errors", []() {
+    const auto fixture = args_fixture::create(
+        {"--threads", "many", "--ratio", "--verbose", "--name", "foo"});
+    char** argv = fixture.argv_data();
+    const options_args args(options, fixture.argc(), argv);
+    const auto& threads = args.get<options.index_of("threads")>();
+    expect(&threads, equal_to(&args.get<options.index_of("threads")>()));
+    expect(threads, equal_to(std::nullopt));
+    expect(*args.get<options.index_of("name")>(), equal_to("foo"));
+    expect(args.errors().size(), equal_to(2));
+    expect(args.errors()[0].option, equal_to("threads"));
+    expect(*args.errors()[0].value, equal_to("many"));
+    expect(args.errors()[1].option, equal_to("ratio"));
+    expect(args.errors()[1].value, equal_to(std::nullopt));
+  });
+
+  // Unknown, missing and out of range flags are all found while parsing.
+  _.test("validation", []() {
+    const auto fixture = args_fixture::create(
+        {"--threads=100", "--colour=red", "--color=green", "--ratio=0.5",
+         "--verbos"});
+    char** argv = fixture.argv_data();
+    const checked_args args(checked, fixture.argc(), argv);
+    expect(args.ok(), equal_to(false));
+    expect(args.get<checked.index_of("threads")>(), equal_to(std::nullopt));
+    expect(args.get<int>("threads"), equal_to(std::nullopt));
+    expect(*args.get<checked.index_of("ratio")>(), equal_to(0.5));
+    expect(args.unknown().size(), equal_to(2));
+    expect(args.unknown()[0], equal_to("colour"));
+    expect(args.unknown()[1], equal_to("verbos"));
+    expect(args.missing().size(), equal_to(1));
+    expect(args.missing()[0], equal_to("name"));
+    expect(args.errors().size(), equal_to(2));
+    expect(args.errors()[0].option, equal_to("threads"));
+    expect(args.errors()[0].reason ==
+               flags::conversion_error::out_of_range,
+           equal_to(true));
+    expect(args.errors()[1].option, equal_to("color"));
+    expect(args.errors()[1].reason == flags::conversion_error::invalid,
+           equal_to(true));
+
+    const auto good = args_fixture::create({"--name=x", "--ratio=0"});
+    char** good_argv = good.argv_data();
+    expect(checked_args(checked, good.argc(), good_argv).ok(),
+           equal_to(true));
+  });
+
+  _.test("help", []() {
+    expect(checked.help(),
+           equal_to("  --threads=<int>     worker threads (1 to 64)\n"
+                    "  --name=<string>     service name (required)\n"
+                    "  --color=<red|blue>\n"
+                    "  --ratio=<number>    (0 to 0.5, required)\n"
+                    "  --verbose           log more\n"));
+  });
+
+  _.test("short options", []() {
+    const auto fixture =
+        args_fixture::create({"-xvj8", "input", "--output", "out", "-v"});
+    char** argv = fixture.argv_data();
+    const letters_args args(letters, fixture.argc(), argv);
+    expect(args.ok(), equal_to(true));
+    expect(*args.get<letters.index_of("v")>(), equal_to(true));
+    expect(*args.get<letters.index_of("x")>(), equal_to(true));
+    expect(*args.get<letters.index_of("j")>(), equal_to(8));
+    expect(*args.get<letters.index_of("output")>(), equal_to("out"));
+    expect(args.count<letters.index_of("v")>(), equal_to(2));
+    // -v takes no value, so input stays positional.
+    expect(args.positional().size(), equal_to(1));
+    expect(letters.help(), equal_to("  -v\n"
+                                    "  -x\n"
+                                    "  -j <int>           jobs\n"
+                                    "  --output=<string>\n"));
+  });
+});
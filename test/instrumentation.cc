@@ -0,0 +1,88 @@
+#define FLAGS_INSTRUMENTATION
+#include "flags.h"
+
+#include <mettle.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace mettle;
+
+namespace {
+char program[] = "TEST";
+char port[] = "--port=8080";
+char verbose[] = "--verbose";
+char name[] = "--name";
+char value[] = "x\"y";
+char* argv[] = {program, port, verbose, name, value, nullptr};
+
+const flags::parse_stats::option_reads* find(const flags::parse_stats& stats,
+                                             const std::string& option) {
+  for (const auto& entry : stats.options) {
+    if (entry.name == option) return &entry;
+  }
+  return nullptr;
+}
+}  // namespace
+
+suite<> instrumentation("instrumentation", [](auto& _) {
+  _.test("reads", []() {
+    const flags::args args(5, argv);
+    args.get<int>("port");
+    args.get<int>("port");
+    args.get<bool>("verbose");
+    args.get<int>("prot");
+    const auto stats = args.stats();
+    expect(stats.options.size(), equal_to(4));
+    expect(find(stats, "port")->reads, equal_to(2));
+    expect(find(stats, "port")->passed, equal_to(true));
+    expect(find(stats, "verbose")->reads, equal_to(1));
+    expect(find(stats, "name")->reads, equal_to(0));
+    expect(find(stats, "prot")->reads, equal_to(1));
+    expect(find(stats, "prot")->passed, equal_to(false));
+    // Passed options come first.
+    expect(stats.options.back().name, equal_to("prot"));
+  });
+
+  _.test("concurrent reads", []() {
+    const flags::args args(5, argv);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+      threads.emplace_back([&args]() {
+        for (int j = 0; j < 1000; ++j) {
+          args.get<int>("port");
+          args.get<int>("missing");
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+    const auto stats = args.stats();
+    expect(find(stats, "port")->reads, equal_to(4000));
+    expect(find(stats, "missing")->reads, equal_to(4000));
+  });
+
+  _.test("allocations", []() {
+    // Three options fit in the inline tables.
+    const flags::args args(5, argv);
+    expect(args.stats().allocations, equal_to(0));
+
+    std::vector<std::string> tokens{"TEST"};
+    for (int i = 0; i < 40; ++i) tokens.push_back("--o" + std::to_string(i));
+    std::vector<char*> many;
+    for (auto& token : tokens) many.push_back(token.data());
+    many.push_back(nullptr);
+    const flags::args spilled(static_cast<int>(tokens.size()), many.data());
+    expect(spilled.stats().allocations, greater(0));
+    expect(spilled.stats().parse_time.count(), greater_equal(0));
+  });
+
+  _.test("json", []() {
+    const flags::args args(5, argv);
+    args.get<std::string>("name");
+    const auto json = args.stats().json();
+    expect(json.find("\"allocations\":0"), not_equal_to(std::string::npos));
+    expect(json.find("{\"name\":\"name\",\"passed\":true,\"reads\":1}"),
+           not_equal_to(std::string::npos));
+    expect(json.find("\"name\":\"port\""), not_equal_to(std::string::npos));
+  });
+});
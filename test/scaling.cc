@@ -0,0 +1,242 @@
+#include "flags.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mettle.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace mettle;
+
+// Stress tests for pathological command lines. They assert ceilings on the
+// allocations of detail::parser, so that a change that starts copying values
+// or allocating per token fails here and not only in the benchmarks. With
+// FLAGS_TIMING_TESTS set in the environment, they also check that run time
+// grows linearly; that is off by default since it is only reliable on an
+// otherwise idle machine.
+
+namespace {
+// What a counting_allocator has been asked for.
+struct allocation_log {
+  std::size_t allocations = 0;
+  std::size_t bytes = 0;
+};
+
+// Forwards to std::allocator and records every allocation in a log shared by
+// all of its rebound copies.
+template <class T>
+struct counting_allocator {
+  using value_type = T;
+
+  explicit counting_allocator(allocation_log* log) : log(log) {}
+  template <class U>
+  counting_allocator(const counting_allocator<U>& other) : log(other.log) {}
+
+  T* allocate(const std::size_t n) {
+    ++log->allocations;
+    log->bytes += n * sizeof(T);
+    return std::allocator<T>().allocate(n);
+  }
+  void deallocate(T* p, const std::size_t n) {
+    std::allocator<T>().deallocate(p, n);
+  }
+
+  template <class U>
+  bool operator==(const counting_allocator<U>& other) const {
+    return log == other.log;
+  }
+  template <class U>
+  bool operator!=(const counting_allocator<U>& other) const {
+    return log != other.log;
+  }
+
+  allocation_log* log;
+};
+
+using counted_parser = flags::detail::basic_parser<counting_allocator<char>>;
+
+// Owns a synthetic argv: argv[0] is the program name, argv[argc] is null.
+struct command_line {
+  command_line() { tokens.emplace_back("TEST"); }
+
+  void add(std::string token) { tokens.push_back(std::move(token)); }
+
+  int argc() {
+    pointers.clear();
+    for (auto& token : tokens) pointers.push_back(token.data());
+    pointers.push_back(nullptr);
+    return static_cast<int>(tokens.size());
+  }
+  char** argv() { return pointers.data(); }
+
+  std::vector<std::string> tokens;
+  std::vector<char*> pointers;
+};
+
+// The number of times a container has to double to reach size.
+std::size_t doublings(std::size_t size) {
+  std::size_t count = 0;
+  for (; size > 1; size = (size + 1) / 2) ++count;
+  return count;
+}
+
+// Each of the parser's tables grows by doubling, so an input of n tokens may
+// cost a few allocations per doubling, and no more than a constant number of
+// bytes per token. tables is how many of them grow with this input.
+std::size_t allocation_ceiling(const std::size_t tokens,
+                               const std::size_t tables) {
+  return tables * (doublings(tokens) + 2) + 8;
+}
+constexpr std::size_t bytes_per_token = 320;
+
+// The best of three parses, in nanoseconds.
+double parse_time(command_line& line) {
+  const int argc = line.argc();
+  char** argv = line.argv();
+  double best = 0;
+  for (int i = 0; i < 3; ++i) {
+    allocation_log log;
+    const auto start = std::chrono::steady_clock::now();
+    const counted_parser parser(argc, argv, counting_allocator<char>(&log));
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || elapsed.count() < best) best = elapsed.count();
+  }
+  return best;
+}
+
+// Parsing four times the tokens must take about four times as long, give or
+// take the cache misses of the larger tables; a quadratic parse would take
+// sixteen times. Only checked if FLAGS_TIMING_TESTS is set.
+template <class Make>
+void expect_linear_growth(const std::size_t tokens, Make&& make) {
+  if (!std::getenv("FLAGS_TIMING_TESTS")) return;
+  auto small = make(tokens / 4);
+  auto large = make(tokens);
+  expect(parse_time(large) / parse_time(small), less(12.0));
+}
+
+command_line distinct_keys(const std::size_t keys) {
+  command_line line;
+  for (std::size_t i = 0; i < keys; ++i) {
+    line.add("--key" + std::to_string(i) + "=" + std::to_string(i));
+  }
+  return line;
+}
+
+command_line repeated_key(const std::size_t times) {
+  command_line line;
+  for (std::size_t i = 0; i < times; ++i) {
+    line.add("--define=NAME" + std::to_string(i) + "=1");
+  }
+  return line;
+}
+
+command_line skipped_section(const std::size_t tokens) {
+  command_line line;
+  line.add("--before");
+  line.add("--");
+  for (std::size_t i = 0; i < tokens; ++i) {
+    line.add(i % 2 ? "--skipped" + std::to_string(i) : std::to_string(i));
+  }
+  return line;
+}
+}  // namespace
+
+suite<> scaling("scaling", [](auto& _) {
+  _.test("distinct keys", []() {
+    constexpr std::size_t keys = 200000;
+    auto line = distinct_keys(keys);
+    const int argc = line.argc();
+    allocation_log log;
+    const counted_parser parser(argc, line.argv(),
+                                counting_allocator<char>(&log));
+    expect(parser.options().size(), equal_to(keys));
+    expect(parser.values(flags::key("key199999")).size(), equal_to(1));
+    // The option table, its index, the values and the occurrences.
+    expect(log.allocations, less_equal(allocation_ceiling(keys, 4)));
+    expect(log.bytes, less_equal(bytes_per_token * keys));
+    expect_linear_growth(keys, distinct_keys);
+  });
+
+  _.test("repeated key", []() {
+    constexpr std::size_t times = 500000;
+    auto line = repeated_key(times);
+    const int argc = line.argc();
+    allocation_log log;
+    const counted_parser parser(argc, line.argv(),
+                                counting_allocator<char>(&log));
+    expect(parser.options().size(), equal_to(1));
+    // The values and the occurrences.
+    expect(log.allocations, less_equal(allocation_ceiling(times, 2)));
+    expect(log.bytes, less_equal(bytes_per_token * times));
+
+    // Reading them all allocates nothing and copies nothing.
+    const auto before = log.allocations;
+    const auto values = parser.values("define");
+    expect(values.size(), equal_to(times));
+    expect(values[times - 1].data, equal_to(line.argv()[times] + 9));
+    std::size_t total = 0;
+    for (const auto value : flags::values_view<std::string_view>(values)) {
+      total += value->size();
+    }
+    expect(total, greater(times * 7));
+    expect(log.allocations, equal_to(before));
+    expect_linear_growth(times, repeated_key);
+  });
+
+  _.test("long values", []() {
+    command_line line;
+    line.add("--payload=" + std::string(16 << 20, 'x'));
+    line.add("--next");
+    line.add(std::string(16 << 20, 'y'));
+    line.add(std::string(16 << 20, 'z'));
+    const int argc = line.argc();
+    allocation_log log;
+    const counted_parser parser(argc, line.argv(),
+                                counting_allocator<char>(&log));
+    // Values are views into argv: nothing depends on their length.
+    expect(log.bytes, less_equal(1024));
+    const auto payload = parser.values("payload");
+    expect(payload[0].size, equal_to(std::size_t{16 << 20}));
+    expect(payload[0].data, equal_to(line.argv()[1] + 10));
+    expect(parser.values("next")[0].size, equal_to(std::size_t{16 << 20}));
+    expect(parser.positional_arguments().size(), equal_to(1));
+  });
+
+  _.test("skipped section", []() {
+    constexpr std::size_t tokens = 500000;
+    auto line = skipped_section(tokens);
+    const int argc = line.argc();
+    allocation_log log;
+    const counted_parser parser(argc, line.argv(),
+                                counting_allocator<char>(&log));
+    expect(parser.skipped_tokens().size(), equal_to(tokens));
+    expect(parser.options().size(), equal_to(1));
+    // Only the skipped vector grows.
+    expect(log.allocations, less_equal(allocation_ceiling(tokens, 1)));
+    expect(log.bytes, less_equal(4 * sizeof(std::string_view) * tokens));
+    expect_linear_growth(tokens, skipped_section);
+  });
+
+  // The index of a reusable args keeps its capacity, so the same pathological
+  // command line parsed again allocates nothing.
+  _.test("reparse", []() {
+    auto line = distinct_keys(50000);
+    const int argc = line.argc();
+    allocation_log log;
+    counted_parser parser(0, nullptr, counting_allocator<char>(&log));
+    counted_parser::occurrence_buffer occurrences(
+        parser.get_table_allocator());
+    parser.reparse(argc, line.argv(), flags::parse_options(), occurrences);
+    const auto first = log.allocations;
+    parser.reparse(argc, line.argv(), flags::parse_options(), occurrences);
+    expect(log.allocations, equal_to(first));
+    expect(parser.options().size(), equal_to(std::size_t{50000}));
+  });
+});